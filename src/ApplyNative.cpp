@@ -0,0 +1,386 @@
+// ===========================================================
+//
+// ApplyNative.cpp: Apply built-in functions over variants
+//
+// Copyright (C) 2015    Xiuwen Zheng
+//
+// This file is part of SeqArray.
+//
+// SeqArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// SeqArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SeqArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "ReadByVariant.h"
+
+
+// ===================================================================== //
+
+/// A built-in function applied to each variant
+class COREARRAY_DLL_LOCAL CNativeKernel
+{
+public:
+	bool NeedGeno;     ///< whether genotypes are needed
+	bool NeedAllele;   ///< whether allele strings are needed
+
+	CNativeKernel(): NeedGeno(true), NeedAllele(false), NumInvalid(0) { }
+	virtual ~CNativeKernel() { }
+
+	/// initialize before reading variants
+	virtual void Init(int nVariant, int nSample, int nPloidy) { }
+	/// compute variant idx (starting from 0) in the selection
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele) = 0;
+	/// get the result
+	virtual SEXP Result() = 0;
+
+	/// the number of invalid genotypes
+	C_Int64 NumInvalid;
+};
+
+
+// ===========================================================
+
+/// missing rate per variant
+class COREARRAY_DLL_LOCAL CNK_MissingVariant: public CNativeKernel
+{
+public:
+	virtual void Init(int nVariant, int nSample, int nPloidy)
+	{
+		Out.resize(nVariant);
+	}
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele)
+	{
+		size_t m = 0;
+		for (size_t i=0; i < n; i++)
+			if (geno[i] == NA_INTEGER) m ++;
+		Out[idx] = (n > 0) ? (double(m) / n) : R_NaN;
+	}
+	virtual SEXP Result()
+	{
+		SEXP rv = NEW_NUMERIC(Out.size());
+		if (!Out.empty())
+			memcpy(REAL(rv), &Out[0], sizeof(double)*Out.size());
+		return rv;
+	}
+private:
+	vector<double> Out;
+};
+
+
+/// missing rate per sample
+class COREARRAY_DLL_LOCAL CNK_MissingSample: public CNativeKernel
+{
+public:
+	virtual void Init(int nVariant, int nSample, int nPloidy)
+	{
+		Num_Variant = nVariant; Num_Sample = nSample; Num_Ploidy = nPloidy;
+		Sum.assign(nSample, 0);
+	}
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele)
+	{
+		int *pS = &Sum[0];
+		for (int i=0; i < Num_Sample; i++)
+		{
+			for (int j=0; j < Num_Ploidy; j++)
+				if (*geno++ == NA_INTEGER) pS[i] ++;
+		}
+	}
+	virtual SEXP Result()
+	{
+		SEXP rv = NEW_NUMERIC(Num_Sample);
+		double *p = REAL(rv);
+		const double scale = 1.0 / (double(Num_Ploidy) * Num_Variant);
+		for (int i=0; i < Num_Sample; i++)
+			p[i] = Sum[i] * scale;
+		return rv;
+	}
+private:
+	int Num_Variant, Num_Sample, Num_Ploidy;
+	vector<int> Sum;  ///< the numbers of missing alleles per sample
+};
+
+
+/// the number of alleles per site
+class COREARRAY_DLL_LOCAL CNK_NumAllele: public CNativeKernel
+{
+public:
+	CNK_NumAllele() { NeedGeno = false; NeedAllele = true; }
+	virtual void Init(int nVariant, int nSample, int nPloidy)
+	{
+		Out.resize(nVariant);
+	}
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele)
+	{
+		Out[idx] = GetNumOfAllele(allele);
+	}
+	virtual SEXP Result()
+	{
+		SEXP rv = NEW_INTEGER(Out.size());
+		if (!Out.empty())
+			memcpy(INTEGER(rv), &Out[0], sizeof(int)*Out.size());
+		return rv;
+	}
+private:
+	vector<int> Out;
+};
+
+
+/// allele counts, or allele frequencies of all alleles
+class COREARRAY_DLL_LOCAL CNK_AlleleCount: public CNativeKernel
+{
+public:
+	CNK_AlleleCount(bool freq) { NeedAllele = true; Freq = freq; }
+	virtual void Init(int nVariant, int nSample, int nPloidy)
+	{
+		Out.resize(nVariant);
+	}
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele)
+	{
+		int nAllele = GetNumOfAllele(allele);
+		vector<int> &cnt = Out[idx];
+		cnt.assign(nAllele, 0);
+		for (size_t i=0; i < n; i++)
+		{
+			int g = geno[i];
+			if (g != NA_INTEGER)
+			{
+				if ((0 <= g) && (g < nAllele))
+					cnt[g] ++;
+				else
+					NumInvalid ++;
+			}
+		}
+	}
+	virtual SEXP Result()
+	{
+		SEXP rv = PROTECT(NEW_LIST(Out.size()));
+		for (size_t i=0; i < Out.size(); i++)
+		{
+			vector<int> &cnt = Out[i];
+			SEXP v;
+			if (Freq)
+			{
+				v = NEW_NUMERIC(cnt.size());
+				int num = 0;
+				for (size_t j=0; j < cnt.size(); j++) num += cnt[j];
+				const double scale = (num > 0) ? (1.0 / num) : R_NaN;
+				for (size_t j=0; j < cnt.size(); j++)
+					REAL(v)[j] = (num > 0) ? (cnt[j] * scale) : R_NaN;
+			} else {
+				v = NEW_INTEGER(cnt.size());
+				for (size_t j=0; j < cnt.size(); j++)
+					INTEGER(v)[j] = cnt[j];
+			}
+			SET_ELEMENT(rv, i, v);
+			vector<int>().swap(cnt);
+		}
+		UNPROTECT(1);
+		return rv;
+	}
+private:
+	bool Freq;
+	vector< vector<int> > Out;
+};
+
+
+/// allele frequencies of the reference allele given by index or string
+class COREARRAY_DLL_LOCAL CNK_AlleleFreq: public CNativeKernel
+{
+public:
+	/// RefIndex: length 1 or # of selected variants; or RefAllele
+	CNK_AlleleFreq(SEXP Ref)
+	{
+		NeedAllele = true;
+		if (Rf_isString(Ref))
+		{
+			R_xlen_t n = XLENGTH(Ref);
+			RefAllele.resize(n);
+			for (R_xlen_t i=0; i < n; i++)
+				RefAllele[i] = CHAR(STRING_ELT(Ref, i));
+		} else {
+			int *p = INTEGER(Ref);
+			RefIndex.assign(p, p + XLENGTH(Ref));
+		}
+		if (RefAllele.empty() && RefIndex.empty())
+			throw ErrSeqArray("Invalid 'ref.allele'.");
+	}
+	virtual void Init(int nVariant, int nSample, int nPloidy)
+	{
+		if (!RefAllele.empty() && ((int)RefAllele.size() != nVariant))
+			throw ErrSeqArray("Invalid length of 'ref.allele'.");
+		if ((RefIndex.size() > 1) && ((int)RefIndex.size() != nVariant))
+			throw ErrSeqArray("Invalid length of 'ref.allele'.");
+		Out.resize(nVariant);
+	}
+	virtual void Compute(int idx, const int *geno, size_t n,
+		const char *allele)
+	{
+		int ref;
+		bool valid;
+		if (!RefAllele.empty())
+		{
+			ref = GetIndexOfAllele(RefAllele[idx].c_str(), allele);
+			valid = (ref >= 0);
+		} else {
+			ref = (RefIndex.size() > 1) ? RefIndex[idx] : RefIndex[0];
+			valid = (0 <= ref) && (ref < GetNumOfAllele(allele));
+		}
+
+		if (valid)
+		{
+			int num = 0, m = 0;
+			for (size_t i=0; i < n; i++)
+			{
+				int g = geno[i];
+				if (g != NA_INTEGER)
+				{
+					num ++;
+					if (g == ref) m ++;
+				}
+			}
+			Out[idx] = (num > 0) ? (double(m) / num) : R_NaN;
+		} else
+			Out[idx] = R_NaN;
+	}
+	virtual SEXP Result()
+	{
+		SEXP rv = NEW_NUMERIC(Out.size());
+		if (!Out.empty())
+			memcpy(REAL(rv), &Out[0], sizeof(double)*Out.size());
+		return rv;
+	}
+private:
+	vector<int> RefIndex;
+	vector<string> RefAllele;
+	vector<double> Out;
+};
+
+
+
+extern "C"
+{
+// ===========================================================
+// Apply a built-in function over variants
+// ===========================================================
+
+/// Apply a built-in function over the selected variants
+/** Parallel calls are made from R: each process runs the function over its
+ *  own part of the selected variants with its own reader
+**/
+COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Native(SEXP gdsfile, SEXP kernel,
+	SEXP param)
+{
+	const char *kn = CHAR(STRING_ELT(kernel, 0));
+
+	COREARRAY_TRY
+
+		// the built-in function
+		CNativeKernel *K = NULL;
+		if (strcmp(kn, "missing.variant") == 0)
+			K = new CNK_MissingVariant;
+		else if (strcmp(kn, "missing.sample") == 0)
+			K = new CNK_MissingSample;
+		else if (strcmp(kn, "num.allele") == 0)
+			K = new CNK_NumAllele;
+		else if (strcmp(kn, "allele.count") == 0)
+			K = new CNK_AlleleCount(false);
+		else if (strcmp(kn, "allele.freq.list") == 0)
+			K = new CNK_AlleleCount(true);
+		else if (strcmp(kn, "allele.freq") == 0)
+			K = new CNK_AlleleFreq(param);
+		else
+			throw ErrSeqArray("Invalid built-in function '%s'.", kn);
+
+		try {
+			// the selection
+			TInitObject::TSelection &Sel = Init.Selection(gdsfile);
+			// the GDS root node
+			PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
+
+			// init selection
+			if (Sel.Sample.empty())
+			{
+				PdAbstractArray N = GDS_Node_Path(Root, "sample.id", TRUE);
+				int Cnt = GDS_Array_GetTotalCount(N);
+				if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'sample.id'.");
+				Sel.Sample.resize(Cnt, TRUE);
+			}
+			if (Sel.Variant.empty())
+			{
+				PdAbstractArray N = GDS_Node_Path(Root, "variant.id", TRUE);
+				int Cnt = GDS_Array_GetTotalCount(N);
+				if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'variant.id'.");
+				Sel.Variant.resize(Cnt, TRUE);
+			}
+
+			int nVariant = Sel.Variant.count();
+			if (nVariant <= 0)
+				throw ErrSeqArray("There is no selected variant.");
+
+			// the readers
+			CVarApplyByVariant GenoReader;
+			size_t CellCnt = 0;
+			int nPloidy = 0;
+			if (K->NeedGeno)
+			{
+				GenoReader.InitObject(CVariable::ctGenotype, "genotype/data",
+					gdsfile, Sel.Variant, Sel.Sample, false);
+				GenoReader.SetBlockRead(VARIANT_BLOCK_SIZE);
+				nPloidy = GenoReader.DLen[2];
+				CellCnt = size_t(GenoReader.Num_Sample) * nPloidy;
+			}
+			PdAbstractArray Allele = K->NeedAllele ?
+				GDS_Node_Path(Root, "allele", TRUE) : NULL;
+
+			K->Init(nVariant, Sel.Sample.count(), nPloidy);
+
+			// for-loop of the selected variants
+			vector<int> Geno(CellCnt);
+			string AlleleStr;
+			C_Int32 CurVariant = Sel.Variant.next(0);
+			for (int idx=0; idx < nVariant; idx++)
+			{
+				if (K->NeedGeno)
+				{
+					if ((idx > 0) && !GenoReader.NextCell())
+						throw ErrSeqArray("Internal error in reading genotypes.");
+					GenoReader.ReadGenoData(Geno.empty() ? NULL : &Geno[0]);
+				}
+				if (Allele)
+				{
+					static const C_Int32 ONE = 1;
+					GDS_Array_ReadData(Allele, &CurVariant, &ONE, &AlleleStr,
+						svStrUTF8);
+				}
+				K->Compute(idx, Geno.empty() ? NULL : &Geno[0], CellCnt,
+					AlleleStr.c_str());
+				CurVariant = Sel.Variant.next(CurVariant + 1);
+			}
+
+			rv_ans = K->Result();
+			if (K->NumInvalid > 0)
+				warning("Invalid value in 'genotype/data'.");
+
+		} catch (...) {
+			delete K;
+			throw;
+		}
+		delete K;
+
+	COREARRAY_CATCH
+}
+
+} // extern "C"
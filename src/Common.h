@@ -44,6 +44,88 @@ using namespace CoreArray;
 #define NA_RAW     0xFF
 
 
+// ===========================================================
+// Bit-packed Selection
+// ===========================================================
+
+/// the number of bits set in a 64-bit integer
+inline static int POPCNT_U64(C_UInt64 x)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555LL);
+	x = (x & 0x3333333333333333LL) + ((x >> 2) & 0x3333333333333333LL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FLL;
+	return (x * 0x0101010101010101LL) >> 56;
+#endif
+}
+
+/// the number of trailing zero bits in a non-zero 64-bit integer
+inline static int CTZ_U64(C_UInt64 x)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	int n = 0;
+	while (!(x & 1)) { x >>= 1; n ++; }
+	return n;
+#endif
+}
+
+
+/// a logical vector of sample or variant selection, stored in bits
+class COREARRAY_DLL_LOCAL CSelection
+{
+public:
+	CSelection();
+
+	inline size_t size() const { return fSize; }
+	inline bool empty() const { return (fSize == 0); }
+	void clear();
+	/// resize the vector, and new elements are set to val
+	void resize(size_t n, bool val=false);
+
+	/// get the i-th element
+	inline bool operator[] (size_t i) const
+		{ return (fBits[i >> 6] >> (i & 0x3F)) & 0x01; }
+	/// set the i-th element
+	inline void set(size_t i, bool val)
+	{
+		C_UInt64 m = C_UInt64(1) << (i & 0x3F);
+		if (val) fBits[i >> 6] |= m; else fBits[i >> 6] &= ~m;
+		fCount = -1;
+	}
+	/// assign from a C_BOOL array
+	void assign(const C_BOOL *p, size_t n);
+
+	/// the number of selected elements (cached)
+	size_t count() const;
+	/// the index of the first selected element >= i, or size() if none
+	size_t next(size_t i) const;
+	/// the index of the last selected element, or size() if none
+	size_t last() const;
+	/// skip num selected elements from i, return the index after them
+	size_t skip(size_t i, size_t num) const;
+	/// unselect num selected elements from i, return the index after them
+	size_t unselect(size_t i, size_t num);
+
+	/// fill buf with a C_BOOL array of the selection, and return &buf[0]
+	/** buf is owned by the caller, and it should be released after reading,
+	 *  since it takes 8 times the memory of the bit array
+	**/
+	C_BOOL *view(vector<C_BOOL> &buf) const;
+	/// fill out with n elements from the i-th element as a C_BOOL array
+	void get(size_t i, size_t n, C_BOOL *out) const;
+
+private:
+	vector<C_UInt64> fBits;  ///< the bit array
+	size_t fSize;            ///< the number of elements
+	mutable ssize_t fCount;  ///< the number of selected elements, -1 if unknown
+};
+
+
+
 // ===========================================================
 // The Initialized Object
 // ===========================================================
@@ -54,14 +136,38 @@ class COREARRAY_DLL_LOCAL TInitObject
 public:
 	struct TSelection
 	{
-		vector<C_BOOL> Sample;
-		vector<C_BOOL> Variant;
+		CSelection Sample;
+		CSelection Variant;
 	};
 
 	typedef list<TSelection> TSelList;
 
+	/// the cumulative offsets of an index variable (e.g., genotype/@data)
+	struct TIndex
+	{
+		/// Offset[i] is the total length of variants before the i-th variant,
+		/// with Offset[nVariant] the total length
+		vector<C_Int64> Offset;
+
+		/// the index variable which the offsets are loaded from
+		PdAbstractArray Node;
+
+		TIndex(): Node(NULL) { }
+		/// load the offsets from the index variable
+		void Load(PdAbstractArray IndexNode);
+		/// get the raw start and length of n variants from the i-th variant
+		/** throw an exception if they exceed the range of 32-bit integers
+		**/
+		void GetRange(size_t i, size_t n, C_Int32 &Start, C_Int32 &Len) const;
+	};
+
+	/// a list of indices in a file, according to the paths of variables
+	typedef map<string, TIndex> TIndexList;
+
 	TInitObject();
 	TSelection &Selection(SEXP gds);
+	/// get the cached index of a variable, loaded from IndexNode if needed
+	TIndex &Index(SEXP gds, const char *path, PdAbstractArray IndexNode);
 
 	/// a vector of TRUE
 	C_BOOL TRUE_ARRAY[1024];
@@ -72,6 +178,7 @@ public:
 	void Need_GenoBuffer(size_t size);
 
 	map<int, TSelList> _Map;
+	map<int, TIndexList> _IndexMap;
 };
 
 extern TInitObject Init;
@@ -19,8 +19,11 @@
 // along with SeqArray.
 // If not, see <http://www.gnu.org/licenses/>.
 
-#include "Common.h"
+#include "ReadByVariant.h"
 #include <vector>
+#include <cstdio>
+#include <cmath>
+#include <zlib.h>
 
 
 // double quote the text if it is needed
@@ -131,6 +134,341 @@ static const string TO_TEXT(SEXP X, int Start=0, int MaxCnt=-1,
 	return ans;
 }
 
+// ===========================================================
+// Text output of VCF, plain or BGZF-compressed
+// ===========================================================
+
+/// the max size of uncompressed data in a BGZF block
+#define BGZF_BLOCK_SIZE        0xFF00
+/// the max size of a BGZF block
+#define BGZF_MAX_BLOCK_SIZE    65536
+/// the size of text buffer before writing it to the file
+#define VCF_OUT_BUFFER_SIZE    (4*1024*1024)
+
+/// powers of ten, VCF_POW10[i] = 10^(i-4)
+static const double VCF_POW10[] =
+	{ 1e-4, 1e-3, 1e-2, 1e-1, 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+/// a class of writing VCF text to a plain or BGZF-compressed file
+class CVCFTextOut
+{
+public:
+	CVCFTextOut(): _file(NULL), _bgzf(false), _zinit(false), _len(0) { }
+	~CVCFTextOut()
+	{
+		if (_zinit) deflateEnd(&_zs);
+		if (_file) fclose(_file);
+	}
+
+	/// create a file, BGZF-compressed if bgzf = true
+	void Open(const char *fn, bool bgzf)
+	{
+		_file = fopen(fn, "wb");
+		if (!_file)
+			throw ErrSeqArray("Fail to create the file '%s'.", fn);
+		_bgzf = bgzf;
+		if (_bgzf)
+		{
+			memset(&_zs, 0, sizeof(_zs));
+			if (deflateInit2(&_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+					Z_DEFAULT_STRATEGY) != Z_OK)
+				throw ErrSeqArray("Fail to initialize zlib.");
+			_zinit = true;
+			_block.resize(BGZF_MAX_BLOCK_SIZE);
+		}
+		_buf.resize(VCF_OUT_BUFFER_SIZE + BGZF_MAX_BLOCK_SIZE);
+		_len = 0;
+	}
+
+	/// write the remaining text and the BGZF end-of-file marker
+	void Close()
+	{
+		Flush(true);
+		if (_bgzf)
+		{
+			static const C_UInt8 BGZF_EOF[28] = {
+				0x1F, 0x8B, 0x08, 0x04, 0, 0, 0, 0, 0, 0xFF, 0x06, 0, 0x42, 0x43,
+				0x02, 0, 0x1B, 0, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+			Write(BGZF_EOF, sizeof(BGZF_EOF));
+		}
+		FILE *f = _file;
+		_file = NULL;
+		if (fclose(f) != 0)
+			throw ErrSeqArray("Fail to write the file.");
+	}
+
+	inline size_t Length() const { return _len; }
+	/// discard the text after the position pos in the current line
+	inline void Rewind(size_t pos) { _len = pos; }
+
+	inline void Put(char ch)
+	{
+		if (_len >= _buf.size()) Need(1);
+		_buf[_len++] = ch;
+	}
+	inline void Put(const char *s, size_t n)
+	{
+		if (_len + n > _buf.size()) Need(n);
+		memcpy(&_buf[_len], s, n);
+		_len += n;
+	}
+	inline void Put(const char *s) { Put(s, strlen(s)); }
+
+	/// write an integer in decimal
+	void PutInt(int val)
+	{
+		char buf[16], *p = buf + sizeof(buf);
+		unsigned int v = (val < 0) ? (0U - (unsigned int)val) : (unsigned int)val;
+		do {
+			*(--p) = '0' + (v % 10);
+			v /= 10;
+		} while (v > 0);
+		if (val < 0) *(--p) = '-';
+		Put(p, buf + sizeof(buf) - p);
+	}
+
+	/// write a floating-point number, the same as "%0.6g" in printf
+	void PutFloat(double val)
+	{
+		if (val == 0 && 1/val > 0)
+			{ Put('0'); return; }
+		double x = (val < 0) ? -val : val;
+		if ((VCF_POW10[0] <= x) && (x < VCF_POW10[10]))
+		{
+			// the decimal exponent, 10^e <= x < 10^(e+1)
+			int e = 5;
+			while (x < VCF_POW10[e+4]) e --;
+			// six significant digits
+			double y = x * VCF_POW10[9-e];
+			double f = floor(y);
+			if (fabs(y - f - 0.5) > 1e-6)
+			{
+				int m = (int)f + ((y - f > 0.5) ? 1 : 0);
+				if (m >= 1000000) { m /= 10; e ++; }
+				if ((100000 <= m) && (m < 1000000) && (e < 6))
+				{
+					char d[6];
+					for (int i=5; i >= 0; i--) { d[i] = '0' + m % 10; m /= 10; }
+					int nd = 6;
+					while (d[nd-1] == '0') nd --;
+					if (val < 0) Put('-');
+					if (e >= 0)
+					{
+						Put(d, e+1);
+						if (nd > e+1)
+						{
+							Put('.');
+							Put(d + e + 1, nd - e - 1);
+						}
+					} else {
+						Put("0.", 2);
+						for (int i=-1; i > e; i--) Put('0');
+						Put(d, nd);
+					}
+					return;
+				}
+			}
+		}
+		// fall back to printf for the other cases
+		char buf[64];
+		int n = snprintf(buf, sizeof(buf), "%0.6g", val);
+		Put(buf, n);
+	}
+
+	/// write text with double quotes if needed, the same as QuoteText()
+	void PutQuote(const char *p)
+	{
+		const char *s = p;
+		for (; *s; s++)
+		{
+			if (*s==',' || *s==';' || *s=='\"' || *s=='\'' || *s==' ')
+				break;
+		}
+		if (*s == 0)
+		{
+			Put(p, s - p);
+		} else {
+			Put('\"');
+			for (; *p; p++)
+			{
+				if (*p=='\"' || *p=='\'') Put('\\');
+				Put(*p);
+			}
+			Put('\"');
+		}
+	}
+
+	/// called at the end of a line, write the text if the buffer is full
+	inline void LineEnd()
+	{
+		if (_len >= VCF_OUT_BUFFER_SIZE) Flush(false);
+	}
+
+private:
+	FILE *_file;             //< the output file
+	bool _bgzf;              //< whether BGZF-compressed
+	bool _zinit;             //< whether _zs is initialized
+	z_stream _zs;            //< the zlib stream
+	vector<char> _buf;       //< the text buffer
+	size_t _len;             //< the length of text in the buffer
+	vector<C_UInt8> _block;  //< the buffer of a compressed BGZF block
+
+	void Need(size_t n)
+	{
+		size_t sz = _buf.size() * 2;
+		if (sz < _len + n) sz = _len + n;
+		_buf.resize(sz);
+	}
+
+	void Write(const void *p, size_t n)
+	{
+		if (fwrite(p, 1, n, _file) != n)
+			throw ErrSeqArray("Fail to write the file.");
+	}
+
+	/// write the text buffer, and keep a partial BGZF block unless final
+	void Flush(bool final)
+	{
+		if (!_bgzf)
+		{
+			if (_len > 0) Write(&_buf[0], _len);
+			_len = 0;
+			return;
+		}
+		size_t pos = 0;
+		while ((_len - pos >= BGZF_BLOCK_SIZE) || (final && pos < _len))
+		{
+			size_t n = _len - pos;
+			if (n > BGZF_BLOCK_SIZE) n = BGZF_BLOCK_SIZE;
+			WriteBlock(&_buf[pos], n);
+			pos += n;
+		}
+		if (pos > 0)
+		{
+			if (pos < _len)
+				memmove(&_buf[0], &_buf[pos], _len - pos);
+			_len -= pos;
+		}
+	}
+
+	/// compress and write a BGZF block
+	void WriteBlock(const char *p, size_t n)
+	{
+		static const C_UInt8 BGZF_HEADER[16] = {
+			0x1F, 0x8B, 0x08, 0x04, 0, 0, 0, 0, 0, 0xFF, 0x06, 0, 0x42, 0x43,
+			0x02, 0 };
+		const size_t HEAD = 18, TAIL = 8;
+
+		deflateReset(&_zs);
+		_zs.next_in = (Bytef*)p;
+		_zs.avail_in = n;
+		_zs.next_out = &_block[HEAD];
+		_zs.avail_out = BGZF_MAX_BLOCK_SIZE - HEAD - TAIL;
+		int rv = deflate(&_zs, Z_FINISH);
+		if (rv != Z_STREAM_END)
+		{
+			if (rv != Z_OK || n <= 1)
+				throw ErrSeqArray("Fail to compress the BGZF block.");
+			// incompressible data, split it into two blocks
+			WriteBlock(p, n/2);
+			WriteBlock(p + n/2, n - n/2);
+			return;
+		}
+
+		size_t size = HEAD + _zs.total_out + TAIL;
+		C_UInt8 *s = &_block[0];
+		memcpy(s, BGZF_HEADER, sizeof(BGZF_HEADER));
+		s[16] = (size - 1) & 0xFF;
+		s[17] = (size - 1) >> 8;
+		C_UInt32 crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)p, n);
+		C_UInt8 *t = s + HEAD + _zs.total_out;
+		for (int i=0; i < 4; i++) t[i] = (crc >> (8*i)) & 0xFF;
+		for (int i=0; i < 4; i++) t[4+i] = (C_UInt32(n) >> (8*i)) & 0xFF;
+		Write(s, size);
+	}
+};
+
+
+/// get the text of the i-th element of a character vector or a factor
+inline static SEXP TEXT_ELT(SEXP X, SEXP Levels, int i)
+{
+	if (Levels == R_NilValue)
+		return STRING_ELT(X, i);
+	int v = INTEGER(X)[i];
+	if ((v == NA_INTEGER) || (v < 1) || (v > Rf_length(Levels)))
+		return NA_STRING;
+	return STRING_ELT(Levels, v - 1);
+}
+
+/// write values to the VCF text, the same output as TO_TEXT()
+static void OUT_TEXT(CVCFTextOut &Out, SEXP X, int Start=0, int MaxCnt=-1,
+	bool VarLength=false, bool NoBlank=true, int Step=1)
+{
+	const size_t L0 = Out.Length();
+	const int Len = Rf_length(X);
+	// the number of available values
+	const int nAvail = (Len > Start) ? (Len - Start + Step - 1) / Step : 0;
+	if ((MaxCnt < 0) || (MaxCnt > nAvail))
+		MaxCnt = nAvail;
+
+	if (Rf_isFactor(X) || (TYPEOF(X) == STRSXP))
+	{
+		SEXP Levels = Rf_isFactor(X) ? getAttrib(X, R_LevelsSymbol) : R_NilValue;
+		if (VarLength || !NoBlank)
+		{
+			for (; MaxCnt > 0; MaxCnt --)
+			{
+				SEXP s = TEXT_ELT(X, Levels, Start + (MaxCnt-1)*Step);
+				if ((s != NA_STRING) && (CHAR(s)[0] != 0)) break;
+			}
+		}
+		for (int i=0; i < MaxCnt; i ++, Start += Step)
+		{
+			if (i > 0) Out.Put(',');
+			SEXP s = TEXT_ELT(X, Levels, Start);
+			if (s != NA_STRING)
+				Out.PutQuote(CHAR(s));
+			else
+				Out.Put('.');
+		}
+	} else if ((TYPEOF(X) == INTSXP) || (TYPEOF(X) == LGLSXP))
+	{
+		int *Base = INTEGER(X) + Start;
+		if (VarLength || !NoBlank)
+		{
+			for (; MaxCnt > 0; MaxCnt --)
+				if (Base[(MaxCnt-1)*Step] != NA_INTEGER) break;
+		}
+		for (int i=0; i < MaxCnt; i++, Base += Step)
+		{
+			if (i > 0) Out.Put(',');
+			if (*Base != NA_INTEGER)
+				Out.PutInt(*Base);
+			else
+				Out.Put('.');
+		}
+	} else if (TYPEOF(X) == REALSXP)
+	{
+		double *Base = REAL(X) + Start;
+		if (VarLength || !NoBlank)
+		{
+			for (; MaxCnt > 0; MaxCnt --)
+				if (R_finite(Base[(MaxCnt-1)*Step])) break;
+		}
+		for (int i=0; i < MaxCnt; i++, Base += Step)
+		{
+			if (i > 0) Out.Put(',');
+			if (R_finite(*Base))
+				Out.PutFloat(*Base);
+			else
+				Out.Put('.');
+		}
+	}
+
+	if (NoBlank && (Out.Length() == L0))
+		Out.Put('.');
+}
+
 
 /// used in SEQ_OutVCF4
 static vector<int> _VCF4_INFO_Number;    //< 
@@ -362,4 +700,236 @@ COREARRAY_DLL_EXPORT SEXP SEQ_OutVCF4(SEXP X)
 	return ans;
 }
 
+
+/// export to a VCF file, variant by variant without calling R functions
+COREARRAY_DLL_EXPORT SEXP SEQ_ExportVCF4(SEXP gdsfile, SEXP Info, SEXP InfoNum,
+	SEXP Format, SEXP FormatNum, SEXP Header, SEXP vcf_fn, SEXP bgzf)
+{
+	int bgzf_flag = Rf_asLogical(bgzf);
+	if (bgzf_flag == NA_LOGICAL)
+		error("'bgzf' must be TRUE or FALSE.");
+
+	COREARRAY_TRY
+
+		// the selection
+		TInitObject::TSelection &Sel = Init.Selection(gdsfile);
+		// the GDS root node
+		PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
+
+		// init selection
+		if (Sel.Sample.empty())
+		{
+			PdAbstractArray N = GDS_Node_Path(Root, "sample.id", TRUE);
+			int Cnt = GDS_Array_GetTotalCount(N);
+			if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'sample.id'.");
+			Sel.Sample.resize(Cnt, TRUE);
+		}
+		if (Sel.Variant.empty())
+		{
+			PdAbstractArray N = GDS_Node_Path(Root, "variant.id", TRUE);
+			int Cnt = GDS_Array_GetTotalCount(N);
+			if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'variant.id'.");
+			Sel.Variant.resize(Cnt, TRUE);
+		}
+
+		const int nInfo = Rf_length(Info);
+		const int nFormat = Rf_length(Format);
+		if ((Rf_length(InfoNum) != nInfo) || (Rf_length(FormatNum) != nFormat))
+			throw ErrSeqArray("Invalid 'Number' of INFO or FORMAT.");
+		const int *pInfoNum = INTEGER(InfoNum);
+		const int *pFmtNum = INTEGER(FormatNum);
+
+		// ===========================================================
+		// initialize the GDS Node list
+
+		static const char *BasicList[] =
+		{
+			"chromosome", "position", "annotation/id", "allele",
+			"annotation/qual", "annotation/filter", "genotype/data", "phase/data"
+		};
+		const int nBasic = 8;
+		// no phasing information (e.g., haploid), output unphased genotypes
+		const bool HasPhase =
+			(GDS_Node_Path(Root, "phase/data", FALSE) != NULL);
+
+		vector<CVarApplyByVariant> NodeList(nBasic + nInfo + nFormat);
+		for (int i=0; i < (int)NodeList.size(); i++)
+		{
+			if ((i == 7) && !HasPhase) continue;
+			CVarApplyByVariant::TType VarType;
+			string s;
+			if (i < nBasic)
+			{
+				s = BasicList[i];
+				VarType = (i == 6) ? CVarApplyByVariant::ctGenotype :
+					((i == 7) ? CVarApplyByVariant::ctPhase :
+					CVarApplyByVariant::ctBasic);
+			} else if (i < nBasic + nInfo)
+			{
+				s = string("annotation/info/") +
+					CHAR(STRING_ELT(Info, i - nBasic));
+				VarType = CVarApplyByVariant::ctInfo;
+			} else {
+				s = string("annotation/format/") +
+					CHAR(STRING_ELT(Format, i - nBasic - nInfo)) + "/data";
+				VarType = CVarApplyByVariant::ctFormat;
+			}
+			NodeList[i].InitObject(VarType, s.c_str(), gdsfile,
+				Sel.Variant, Sel.Sample, false);
+			NodeList[i].SetBlockRead(VARIANT_BLOCK_SIZE);
+		}
+
+		// ===========================================================
+		// create the file, and write the header
+
+		CVCFTextOut Out;
+		Out.Open(CHAR(STRING_ELT(vcf_fn, 0)), bgzf_flag == TRUE);
+		for (int i=0; i < Rf_length(Header); i++)
+		{
+			Out.Put(CHAR(STRING_ELT(Header, i)));
+			Out.Put('\n');
+		}
+
+		// ===========================================================
+		// for-loop of variants
+
+		int nProtected = 0, nVariant = 0;
+		vector<SEXP> Val(NodeList.size());
+		vector<int> FmtIdx;
+		FmtIdx.reserve(nFormat);
+
+		bool ifend = (Sel.Variant.count() <= 0);
+		while (!ifend)
+		{
+			for (int i=0; i < (int)NodeList.size(); i++)
+			{
+				if ((i == 7) && !HasPhase) continue;
+				Val[i] = NodeList[i].NeedRData(nProtected);
+				NodeList[i].ReadData(Val[i]);
+			}
+
+			// CHROM, POS, ID
+			OUT_TEXT(Out, Val[0]); Out.Put('\t');
+			OUT_TEXT(Out, Val[1]); Out.Put('\t');
+			OUT_TEXT(Out, Val[2]); Out.Put('\t');
+
+			// REF, ALT
+			const char *s = CHAR(STRING_ELT(Val[3], 0)), *p = s;
+			while ((*p != 0) && (*p != ',')) p ++;
+			if (p > s) Out.Put(s, p - s); else Out.Put('.');
+			Out.Put('\t');
+			if (*p != 0)
+			{
+				p ++;
+				Out.Put((*p) ? p : ".");
+			} else
+				Out.Put('.');
+			Out.Put('\t');
+
+			// QUAL, FILTER
+			OUT_TEXT(Out, Val[4]); Out.Put('\t');
+			OUT_TEXT(Out, Val[5]); Out.Put('\t');
+
+			// INFO
+			bool NeedSeparator = false;
+			for (int i=0; i < nInfo; i++)
+			{
+				SEXP D = Val[nBasic + i];
+				const char *nm = CHAR(STRING_ELT(Info, i));
+				if (TYPEOF(D) == LGLSXP)  // FLAG type
+				{
+					if ((Rf_length(D) > 0) && (LOGICAL(D)[0] == TRUE))
+					{
+						if (NeedSeparator) Out.Put(';');
+						NeedSeparator = true;
+						Out.Put(nm);
+					}
+				} else if (!isNull(D))
+				{
+					size_t pos = Out.Length();
+					if (NeedSeparator) Out.Put(';');
+					Out.Put(nm);
+					Out.Put('=');
+					size_t pos2 = Out.Length();
+					int L = pInfoNum[i];
+					OUT_TEXT(Out, D, 0, (L < 0) ? -1 : L, (L < 0), false);
+					if (Out.Length() > pos2)
+						NeedSeparator = true;
+					else
+						Out.Rewind(pos);
+				}
+			}
+			if (!NeedSeparator) Out.Put('.');
+			Out.Put('\t');
+
+			// FORMAT
+			Out.Put("GT", 2);
+			FmtIdx.clear();
+			for (int i=0; i < nFormat; i++)
+			{
+				if (!isNull(Val[nBasic + nInfo + i]))
+				{
+					Out.Put(':');
+					Out.Put(CHAR(STRING_ELT(Format, i)));
+					FmtIdx.push_back(i);
+				}
+			}
+			Out.Put('\t');
+
+			// genotypes and phasing information
+			const int NumAllele = NodeList[6].DLen[2];
+			const int NumSample = NodeList[6].Num_Sample;
+			if (HasPhase && (Rf_length(Val[7]) != (NumAllele-1)*NumSample))
+				throw ErrSeqArray("Invalid dimension of phasing information.");
+			const int *pSamp = INTEGER(Val[6]);
+			const int *pPhase = HasPhase ? INTEGER(Val[7]) : NULL;
+
+			for (int i=0; i < NumSample; i ++)
+			{
+				for (int j=0; j < NumAllele; j++, pSamp++)
+				{
+					if (j > 0)
+						Out.Put((pPhase && *pPhase++) ? '|' : '/');
+					if (*pSamp != NA_INTEGER)
+						Out.PutInt(*pSamp);
+					else
+						Out.Put('.');
+				}
+				for (int k=0; k < (int)FmtIdx.size(); k++)
+				{
+					Out.Put(':');
+					SEXP D = Val[nBasic + nInfo + FmtIdx[k]];
+					int nTotal = Rf_length(D);
+					if ((nTotal % NumSample) != 0)
+						throw ErrSeqArray("Internal Error: invalid dimension.");
+					int L = pFmtNum[FmtIdx[k]];
+					if (L < 0)
+						OUT_TEXT(Out, D, i, nTotal / NumSample, true, true, NumSample);
+					else
+						OUT_TEXT(Out, D, i, L, false, true, NumSample);
+				}
+				if (i < (NumSample-1)) Out.Put('\t');
+			}
+
+			Out.Put('\n');
+			Out.LineEnd();
+			nVariant ++;
+
+			// check the end
+			for (int i=0; i < (int)NodeList.size(); i++)
+			{
+				if ((i == 7) && !HasPhase) continue;
+				if (!NodeList[i].NextCell())
+					{ ifend = true; break; }
+			}
+		}
+
+		Out.Close();
+		UNPROTECT(nProtected);
+
+		rv_ans = ScalarInteger(nVariant);
+
+	COREARRAY_CATCH
+}
+
 } // extern "C"
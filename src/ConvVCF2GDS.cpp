@@ -22,7 +22,11 @@
 #include "Common.h"
 #include <vector>
 #include <set>
+#include <map>
 #include <algorithm>
+#include <zlib.h>
+#include <time.h>
+#include <sys/time.h>
 
 
 
@@ -33,10 +37,35 @@
 static const string BlackString;
 
 
+/// append a vector to the end of another vector
+template<typename TYPE>
+	inline static void _Concat(vector<TYPE> &dst, const vector<TYPE> &src)
+{
+	dst.insert(dst.end(), src.begin(), src.end());
+}
+
+/// the wall-clock time in seconds, for the timing counters
+static double VCF_Now()
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+#endif
+}
+
+
 // ===========================================================
 // the structure of read line
 // ===========================================================
 
+/// the initial size of buffer for reading a VCF file
+#define READLINE_BUFFER_SIZE    (4*1024*1024)
+
 /// a class of parsing text
 class CReadLine
 {
@@ -45,14 +74,16 @@ public:
 	CReadLine()
 	{
 		_ReadFun = _Rho = R_NilValue;
+		_file = NULL;
 		_ptr_line = _lines.end();
-		_ifend = false; _line_no = _column_no = 0;
-		_cur_char = NULL;
+		_ifend = false; _line_no = 0;
+		_buf_len = _buf_rest = 0;
 		nProt = 0;
 	}
 	/// constructor
 	CReadLine(SEXP vFun, SEXP vRho)
 	{
+		_file = NULL;
 		Init(vFun, vRho);
 	}
 
@@ -60,6 +91,8 @@ public:
 	{
 		if (nProt > 0)
 			UNPROTECT(nProt);
+		if (_file)
+			gzclose(_file);
 	}
 
 	/// initialize R call
@@ -67,11 +100,22 @@ public:
 	{
 		_ReadFun = vFun; _Rho = vRho;	
 		_lines.clear(); _ptr_line = _lines.end();
-		_ifend = false; _line_no = _column_no = 0;
-		_cur_char = NULL;
+		_ifend = false; _line_no = 0;
 		nProt = 0;
 	}
 
+	/// initialize with a plain or gzip/BGZF-compressed text file
+	void InitFile(const char *fn)
+	{
+		Init(R_NilValue, R_NilValue);
+		_file = gzopen(fn, "rb");
+		if (!_file)
+			throw ErrSeqArray("Fail to open '%s'.", fn);
+		gzbuffer(_file, 1024*1024);
+		_buffer.resize(READLINE_BUFFER_SIZE);
+		_buf_len = _buf_rest = 0;
+	}
+
 	/// read a line
 	const char *ReadLine()
 	{
@@ -92,53 +136,6 @@ public:
 		}
 	}
 
-	/// get a string with a seperator '\t'
-	void GetCell(string &buffer, bool last_column)
-	{
-		if (_ifend)
-			throw ErrSeqArray("It is the end.");
-		if (!_cur_char)
-		{
-			_cur_char = ReadLine();
-			if (!_cur_char)
-				throw ErrSeqArray("It is the end.");
-			_column_no = 0;
-		}
-
-		const char *str_begin = _cur_char;
-		while ((*_cur_char != '\t') && (*_cur_char != 0))
-			_cur_char ++;
-		const char *str_end = _cur_char;
-		_column_no ++;
-
-		// check
-		if ((str_begin == str_end) && (*_cur_char == 0))
-			throw ErrSeqArray("fewer columns than what expected.");
-		if (last_column)
-		{
-			if (*_cur_char != 0)
-				throw ErrSeqArray("more columns than what expected.");
-			_cur_char = NULL;
-		} else {
-			if (*_cur_char == '\t') _cur_char ++;
-		}
-
-		if (str_end > str_begin+1)
-		{
-			if ((str_begin[0] == '\"') && (str_end[-1] == '\"'))
-			{
-				str_begin ++;
-				str_end --;
-			} else if ((str_begin[0] == '\'') && (str_end[-1] == '\''))
-			{
-				str_begin ++;
-				str_end --;
-			}
-		}
-
-		buffer.assign(str_begin, str_end);
-	}
-
 	/// return true, if it is of the end
 	bool IfEnd()
 	{
@@ -152,22 +149,25 @@ public:
 
 	/// return line number
 	COREARRAY_INLINE int LineNo() { return _line_no; }
-	/// return column number
-	COREARRAY_INLINE int ColumnNo() { return _column_no; }
 
 protected:
 	SEXP _ReadFun;  //< R call function
 	SEXP _Rho;      //< R environment
+	gzFile _file;   //< the input file, or NULL if calling R function
+	vector<char> _buffer;  //< the buffer of text read from _file
+	size_t _buf_len;       //< the number of bytes in _buffer
+	size_t _buf_rest;      //< the start of the incomplete line in _buffer
 	vector<const char *> _lines;               //< store returned string(s)
 	vector<const char *>::iterator _ptr_line;  //< the pointer to _lines
 	bool _ifend;     //< true for the end of reading
 	int _line_no;    //< the index of current line
-	int _column_no;  //< the index of current column
-	const char *_cur_char;  //< 
 	int nProt;
 
 	bool _PrepareBuffer()
 	{
+		if (_file)
+			return _PrepareFileBuffer();
+
 		if (nProt > 0)
 		{
 			UNPROTECT(nProt);
@@ -194,6 +194,75 @@ protected:
 			return false;
 		}
 	}
+
+	/// split the text read from _file into lines in place
+	bool _PrepareFileBuffer()
+	{
+		// move the incomplete line to the beginning
+		size_t n = _buf_len - _buf_rest;
+		if (n > 0)
+			memmove(&_buffer[0], &_buffer[_buf_rest], n);
+		_buf_len = n; _buf_rest = 0;
+		_lines.clear();
+
+		while (_lines.empty())
+		{
+			// the incomplete line fills the buffer
+			if (_buf_len >= _buffer.size() - 1)
+				_buffer.resize(_buffer.size() * 2);
+
+			// read
+			int cnt = gzread(_file, &_buffer[_buf_len],
+				_buffer.size() - _buf_len - 1);
+			if (cnt < 0)
+			{
+				int err;
+				throw ErrSeqArray("Fail to read the file: %s.",
+					gzerror(_file, &err));
+			}
+			size_t st = _buf_len;
+			_buf_len += cnt;
+
+			// split lines
+			char *base = &_buffer[0];
+			char *p = base + st, *end = base + _buf_len;
+			char *line = base + _buf_rest;
+			for (; p < end; p++)
+			{
+				if (*p == '\n')
+				{
+					*p = 0;
+					if ((p > line) && (p[-1] == '\r')) p[-1] = 0;
+					_lines.push_back(line);
+					line = p + 1;
+				}
+			}
+			_buf_rest = line - base;
+
+			if (cnt == 0)
+			{
+				// the last line without '\n'
+				if (_buf_rest < _buf_len)
+				{
+					base[_buf_len] = 0;
+					if (base[_buf_len-1] == '\r') base[_buf_len-1] = 0;
+					_lines.push_back(base + _buf_rest);
+					_buf_rest = _buf_len;
+				}
+				break;
+			}
+		}
+
+		if (!_lines.empty())
+		{
+			_ifend = false;
+			_ptr_line = _lines.begin();
+			return true;
+		} else {
+			_ifend = true;
+			return false;
+		}
+	}
 };
 
 
@@ -209,6 +278,32 @@ const static int FIELD_TYPE_FLAG     = 3;
 const static int FIELD_TYPE_STRING   = 4;
 
 
+/// the values of an INFO or FORMAT field parsed from lines, to be appended
+struct TVCF_Field_Buffer
+{
+	vector<C_Int32> I32;   //< data -- Int32 (also used for flags)
+	vector<double> F64;    //< data -- Float64
+	vector<string> UTF8;   //< data -- UTF8 string
+	vector<C_Int32> Len;   //< the values appended to 'len_obj'
+
+	void Clear()
+	{
+		I32.clear(); F64.clear(); UTF8.clear(); Len.clear();
+	}
+
+	void Append(const TVCF_Field_Buffer &B)
+	{
+		_Concat(I32, B.I32); _Concat(F64, B.F64);
+		_Concat(UTF8, B.UTF8); _Concat(Len, B.Len);
+	}
+
+	/// the data vector of a specified type
+	COREARRAY_INLINE vector<C_Int32> &Data(C_Int32*) { return I32; }
+	COREARRAY_INLINE vector<double> &Data(double*) { return F64; }
+	COREARRAY_INLINE vector<string> &Data(string*) { return UTF8; }
+};
+
+
 /// the structure of INFO field
 struct TVCF_Field_Info
 {
@@ -230,7 +325,8 @@ struct TVCF_Field_Info
 
 	// INFO field
 
-	template<typename TYPE> void Check(vector<TYPE> &array, string &name, int num_allele)
+	template<typename TYPE> void Check(vector<TYPE> &array, int num_allele,
+		TVCF_Field_Buffer &buf)
 	{
 		C_Int32 I32;
 		switch (number)
@@ -238,7 +334,7 @@ struct TVCF_Field_Info
 			case -1:
 				// variable-length
 				I32 = array.size();
-				GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+				buf.Len.push_back(I32);
 				break;		
 
 			case -2:
@@ -249,7 +345,7 @@ struct TVCF_Field_Info
 					throw ErrSeqArray("INFO ID '%s' should have %d value(s).",
 						name.c_str(), num_allele-1);
 				}
-				GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+				buf.Len.push_back(I32);
 				break;		
 
 			case -3:
@@ -260,7 +356,7 @@ struct TVCF_Field_Info
 					throw ErrSeqArray("INFO ID '%s' should have %d value(s).",
 						name.c_str(), (num_allele+1)*num_allele/2);
 				}
-				GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+				buf.Len.push_back(I32);
 				break;		
 
 			default:
@@ -274,20 +370,134 @@ struct TVCF_Field_Info
 				} else
 					throw ErrSeqArray("Invalid value 'number' in TVCF_Field_Info.");
 		}
+
+		vector<TYPE> &D = buf.Data((TYPE*)NULL);
+		D.insert(D.end(), array.begin(), array.end());
 	}
 
-	template<typename TYPE> void Fill(vector<TYPE> &array, TYPE val)
+	template<typename TYPE> void Fill(TYPE val, TVCF_Field_Buffer &buf)
 	{
 		if (number < 0)
 		{
-			C_Int32 I32 = 0;
-			GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+			buf.Len.push_back(0);
+		} else {
+			vector<TYPE> &D = buf.Data((TYPE*)NULL);
+			D.insert(D.end(), number, val);
+		}
+	}
+};
+
+
+/// a flat buffer of the values of all samples, the values of sample i are in
+///   [i*stride, i*stride + Num(i)), and the stride regrows geometrically, so
+///   refilling the buffer for each line does not allocate memory
+template<typename TYPE> class CVCFArena
+{
+public:
+	/// the values of a sample, with the methods of vector used in parsing
+	class TSlot
+	{
+	public:
+		TSlot(CVCFArena<TYPE> &a, int i): _a(a), _i(i)
+		{
+			_base = &a._buf[(size_t)a._stride * i];
+			_num = &a._num[i];
+			_stride = a._stride;
+		}
+
+		COREARRAY_INLINE size_t size() const { return *_num; }
+		COREARRAY_INLINE void clear() { *_num = 0; }
+		COREARRAY_INLINE TYPE &operator[] (size_t k) { return _base[k]; }
+
+		/// append a value and return it, an old string keeps its capacity
+		COREARRAY_INLINE TYPE &next()
+		{
+			const int n = *_num;
+			if (n >= _stride)
+			{
+				_a.Grow(n + 1);
+				_base = &_a._buf[(size_t)_a._stride * _i];
+				_stride = _a._stride;
+			}
+			*_num = n + 1;
+			return _base[n];
+		}
+		COREARRAY_INLINE void push_back(const TYPE &val) { next() = val; }
+		void resize(size_t n, const TYPE &val)
+		{
+			while (size() < n) push_back(val);
+			*_num = n;
+		}
+
+	private:
+		CVCFArena<TYPE> &_a;
+		int _i;
+		TYPE *_base;  //< the first value of the sample
+		int *_num;    //< the number of values of the sample
+		int _stride;  //< the stride when '_base' is set
+	};
+
+	CVCFArena() { _stride = 0; }
+
+	/// allocate 'stride' values for each of 'nSample' samples
+	void Init(int nSample, int stride)
+	{
+		_stride = (stride > 0) ? stride : 1;
+		_num.assign(nSample, 0);
+		_buf.clear();
+		_buf.resize((size_t)nSample * _stride);
+	}
+
+	COREARRAY_INLINE TSlot operator[] (int i) { return TSlot(*this, i); }
+	COREARRAY_INLINE int Num(int i) const { return _num[i]; }
+	COREARRAY_INLINE const TYPE *Ptr(int i) const
+		{ return &_buf[(size_t)_stride*i]; }
+
+	/// append the first n values of each sample to a vector
+	void AppendTo(vector<TYPE> &out, int n) const
+	{
+		if (n == _stride)
+		{
+			// the values of all samples are contiguous
+			out.insert(out.end(), _buf.begin(), _buf.end());
 		} else {
-			array.clear();
-			array.resize(number, val);
-			GDS_Array_AppendData(data_obj, number, &(array[0]),
-				TdTraits<TYPE>::SVType);
+			for (size_t i=0; i < _num.size(); i++)
+			{
+				const TYPE *p = &_buf[(size_t)_stride*i];
+				out.insert(out.end(), p, p + n);
+			}
+		}
+	}
+
+	/// the maximum number of values over samples
+	int MaxNum() const
+	{
+		int n = 0;
+		for (vector<int>::const_iterator it=_num.begin(); it != _num.end(); it++)
+			if (n < *it) n = *it;
+		return n;
+	}
+
+private:
+	friend class TSlot;
+
+	vector<TYPE> _buf;  //< nSample x _stride values
+	vector<int> _num;   //< the number of values of each sample
+	int _stride;        //< the number of values allocated for each sample
+
+	/// double the stride (at least n), and move the values of each sample
+	void Grow(int n)
+	{
+		int stride = _stride * 2;
+		if (stride < n) stride = n;
+		vector<TYPE> buf((size_t)_num.size() * stride);
+		for (size_t i=0; i < _num.size(); i++)
+		{
+			TYPE *s = &_buf[i*_stride], *d = &buf[i*stride];
+			for (int k=0; k < _num[i]; k++) std::swap(s[k], d[k]);
 		}
+		_buf.swap(buf);
+		_stride = stride;
 	}
 };
 
@@ -304,11 +514,11 @@ struct TVCF_Field_Format
 	bool used;           //< if TRUE, it has been parsed for the current line
 
 	/// data -- Int32
-	vector< vector<C_Int32> > I32ss;
+	CVCFArena<C_Int32> I32ss;
 	/// data -- C_Float32
-	vector< vector<C_Float64> > F64ss;
+	CVCFArena<C_Float64> F64ss;
 	/// data -- UTF8 string
-	vector< vector<string> > UTF8ss;
+	CVCFArena<string> UTF8ss;
 
 
 	TVCF_Field_Format()
@@ -319,9 +529,27 @@ struct TVCF_Field_Format
 		used = false;
 	}
 
+	/// allocate the buffer of values for all samples
+	void Init(int nSample)
+	{
+		// 3 values for Number=G of biallelic sites
+		const int n = (number > 0) ? number : ((number == -3) ? 3 : 1);
+		switch (type)
+		{
+			case FIELD_TYPE_INT:
+				I32ss.Init(nSample, n); break;
+			case FIELD_TYPE_FLOAT:
+				F64ss.Init(nSample, n); break;
+			case FIELD_TYPE_STRING:
+				UTF8ss.Init(nSample, n); break;
+			default:
+				throw ErrSeqArray("Invalid FORMAT Type.");
+		}
+	}
+
 	// FORMAT field
 
-	template<typename TYPE> void Check(vector<TYPE> &array, string &name,
+	template<class TVEC, typename TYPE> void Check(TVEC &array,
 		int num_allele, const TYPE &missing)
 	{
 		switch (number)
@@ -366,7 +594,7 @@ struct TVCF_Field_Format
 		}
 	}
 
-	void WriteFixedLength()
+	void WriteFixedLength(TVCF_Field_Buffer &buf)
 	{
 		if (number < 0)
 		{
@@ -376,39 +604,18 @@ struct TVCF_Field_Format
 		switch (type)
 		{
 			case FIELD_TYPE_INT:
-				for (vector< vector<C_Int32> >::iterator it = I32ss.begin();
-					it != I32ss.end(); it ++)
-				{
-					GDS_Array_AppendData(data_obj, number, &((*it)[0]), svInt32);
-				}
-				break;
-
+				I32ss.AppendTo(buf.I32, number); break;
 			case FIELD_TYPE_FLOAT:
-				for (vector< vector<double> >::iterator it = F64ss.begin();
-					it != F64ss.end(); it ++)
-				{
-					GDS_Array_AppendData(data_obj, number, &((*it)[0]), svFloat64);
-				}
-				break;
-
+				F64ss.AppendTo(buf.F64, number); break;
 			case FIELD_TYPE_STRING:
-				for (vector< vector<string> >::iterator it = UTF8ss.begin();
-					it != UTF8ss.end(); it ++)
-				{
-					vector<string> &text = (*it);
-					size_t n = text.size();
-					for (size_t j=0; j < n; j ++)
-						GDS_Array_AppendString(data_obj, text[j].c_str());
-				}
-				break;
+				UTF8ss.AppendTo(buf.UTF8, number); break;
 
 			default:
 				throw ErrSeqArray("Invalid FORMAT Type.");
 		}
 	}
 
-	int WriteVariableLength(int nTotalSample, vector<C_Int32> &I32s,
-		vector<double> &F64s)
+	int WriteVariableLength(int nTotalSample, TVCF_Field_Buffer &buf)
 	{
 		if (number >= 0)
 		{
@@ -419,56 +626,39 @@ struct TVCF_Field_Format
 		switch (type)
 		{
 			case FIELD_TYPE_INT:
-				for (int j=0; j < nTotalSample; j++)
-				{
-					if (nMax < (int)I32ss[j].size())
-						nMax = I32ss[j].size();
-				}
-				I32s.resize(nTotalSample);
+				nMax = I32ss.MaxNum();
 				for (int i=0; i < nMax; i++)
 				{
 					for (int j=0; j < nTotalSample; j++)
 					{
-						vector<C_Int32> &B = I32ss[j];
-						I32s[j] = (i < (int)B.size()) ? B[i] : NA_INTEGER;
+						buf.I32.push_back((i < I32ss.Num(j)) ?
+							I32ss.Ptr(j)[i] : NA_INTEGER);
 					}
-					GDS_Array_AppendData(data_obj, nTotalSample,
-						&(I32s[0]), svInt32);
 				}
 				break;
 
 			case FIELD_TYPE_FLOAT:
-				for (int j=0; j < nTotalSample; j++)
-				{
-					if (nMax < (int)F64ss[j].size())
-						nMax = F64ss[j].size();
-				}
-				F64s.resize(nTotalSample);
+				nMax = F64ss.MaxNum();
 				for (int i=0; i < nMax; i++)
 				{
 					for (int j=0; j < nTotalSample; j++)
 					{
-						vector<double> &L = F64ss[j];
-						F64s[j] = (i < (int)L.size()) ? L[i] : R_NaN;
+						buf.F64.push_back((i < F64ss.Num(j)) ?
+							F64ss.Ptr(j)[i] : R_NaN);
 					}
-					GDS_Array_AppendData(data_obj, nTotalSample,
-						&(F64s[0]), svFloat64);
 				}
 				break;
 
 			case FIELD_TYPE_STRING:
-				for (int j=0; j < nTotalSample; j++)
-				{
-					if (nMax < (int)UTF8ss[j].size())
-						nMax = UTF8ss[j].size();
-				}
+				nMax = UTF8ss.MaxNum();
 				for (int i=0; i < nMax; i++)
 				{
 					for (int j=0; j < nTotalSample; j++)
 					{
-						vector<string> &B = UTF8ss[j];
-						GDS_Array_AppendString(data_obj,
-							(i < (int)B.size()) ? B[i].c_str() : "");
+						if (i < UTF8ss.Num(j))
+							buf.UTF8.push_back(UTF8ss.Ptr(j)[i]);
+						else
+							buf.UTF8.push_back(string());
 					}
 				}
 				break;
@@ -481,30 +671,169 @@ struct TVCF_Field_Format
 };
 
 
+/// a span of characters in the line buffer without copying
+struct TVCF_Span
+{
+	const char *Ptr;  //< the first character
+	const char *End;  //< the position after the last character
+
+	TVCF_Span() { Ptr = End = NULL; }
+
+	COREARRAY_INLINE bool Empty() const { return Ptr >= End; }
+	COREARRAY_INLINE size_t Len() const { return End - Ptr; }
+	/// whether it is "."
+	COREARRAY_INLINE bool IsMissing() const
+		{ return (End == Ptr+1) && (*Ptr == '.'); }
+	/// whether it is equal to a string
+	COREARRAY_INLINE bool Equal(const string &s) const
+		{ return (s.size() == Len()) && (memcmp(s.data(), Ptr, Len()) == 0); }
+	/// return a copy
+	COREARRAY_INLINE string Str() const
+		{ return Empty() ? string() : string(Ptr, End); }
+};
+
+
 /// trim blank characters
-static void _Trim_(string &val)
+static void _Trim_(TVCF_Span &val)
+{
+	while ((val.Ptr < val.End) && ((*val.Ptr == ' ') || (*val.Ptr == '\t')))
+		val.Ptr ++;
+	while ((val.End > val.Ptr) && ((val.End[-1] == ' ') || (val.End[-1] == '\t')))
+		val.End --;
+}
+
+/// append a span to a list of strings
+inline static void _PushString(vector<string> &list, const TVCF_Span &val)
+{
+	list.push_back(BlackString);
+	if (!val.Empty()) list.back().assign(val.Ptr, val.End);
+}
+
+/// whether it is a white-space character in the C locale
+#define VCF_IS_SPACE(c)    (((c) == ' ') || (((c) >= '\t') && ((c) <= '\r')))
+/// whether it is a decimal digit
+#define VCF_IS_DIGIT(c)    ((unsigned char)((c) - '0') < 10)
+
+/// the powers of 10 which are exactly represented in double
+static const double VCF_POW10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// parse a decimal integer without locale like strtol(p, &endptr, 10)
+/** \param p    the text, terminated by any non-digit character
+ *  \param val  the output, saturated if it is out of the range of int64
+ *  \return the position after the integer, or p if no conversion
+**/
+static const char *_StrToInt(const char *p, C_Int64 &val)
+{
+	const char *s = p;
+	while (VCF_IS_SPACE(*p)) p ++;
+	bool neg = false;
+	if ((*p == '-') || (*p == '+'))
+		{ neg = (*p == '-'); p ++; }
+	if (!VCF_IS_DIGIT(*p)) return s;
+
+	C_Int64 v = 0;
+	for (; VCF_IS_DIGIT(*p); p++)
+	{
+		if (v < 100000000000000000LL)
+			v = v*10 + (*p - '0');
+	}
+	val = neg ? -v : v;
+	return p;
+}
+
+/// parse a real number without locale like strtod(p, &endptr)
+/** decimal numbers with no more than 19 significant digits and a power of 10
+ *  in [-22, 22] are converted exactly with one rounding (Clinger's fast
+ *  path), the others (and inf, nan, hexadecimal) are passed to strtod()
+ *  \param p    the text, terminated by a separator
+ *  \param val  the output
+ *  \return the position after the number, or p if no conversion
+**/
+static const char *_StrToFloat(const char *p, double &val)
 {
-	const char *st = val.c_str();
-	const char *p = st;
-	while ((*p == ' ') || (*p == '\t')) p ++;
-	if (p != st) val.erase(0, p - st);
+	const char *s = p;
+	while (VCF_IS_SPACE(*p)) p ++;
+	const char *st = p;
+	bool neg = false;
+	if ((*p == '-') || (*p == '+'))
+		{ neg = (*p == '-'); p ++; }
+	const char *sd = p;
+
+	C_UInt64 m = 0;
+	int nd=0, exp10=0;
+	bool any = false;
+	// integer part
+	for (; VCF_IS_DIGIT(*p); p++)
+	{
+		if (nd >= 19) goto slow;
+		m = m*10 + (*p - '0');
+		if (m > 0) nd ++;
+		any = true;
+	}
+	if ((*p == 'x') || (*p == 'X')) goto slow;
+	// fraction part
+	if (*p == '.')
+	{
+		p ++;
+		for (; VCF_IS_DIGIT(*p); p++)
+		{
+			if (nd >= 19) goto slow;
+			m = m*10 + (*p - '0');
+			if (m > 0) nd ++;
+			exp10 --;
+			any = true;
+		}
+	}
+	if (!any)
+	{
+		if ((*sd=='i') || (*sd=='I') || (*sd=='n') || (*sd=='N')) goto slow;
+		return s;
+	}
+	// exponent part
+	if ((*p == 'e') || (*p == 'E'))
+	{
+		const char *q = p + 1;
+		bool eneg = false;
+		if ((*q == '-') || (*q == '+'))
+			{ eneg = (*q == '-'); q ++; }
+		if (VCF_IS_DIGIT(*q))
+		{
+			int e = 0;
+			for (; VCF_IS_DIGIT(*q); q++)
+				if (e < 100000) e = e*10 + (*q - '0');
+			exp10 += eneg ? -e : e;
+			p = q;
+		}
+	}
 
-	int L = val.size();
-	p = val.c_str() + L - 1;
-	while (L > 0)
+	if (m == 0)
 	{
-		if ((*p != ' ') && (*p != '\t')) break;
-		L --; p --;
+		val = neg ? -0.0 : 0.0;
+		return p;
+	} else if ((m <= (C_UInt64(1) << 53)) && (-22 <= exp10) && (exp10 <= 22))
+	{
+		double v = (double)m;
+		v = (exp10 < 0) ? (v / VCF_POW10[-exp10]) : (v * VCF_POW10[exp10]);
+		val = neg ? -v : v;
+		return p;
 	}
-	val.resize(L);
+
+slow:
+	char *endptr = (char*)st;
+	val = strtod(st, &endptr);
+	return (endptr == st) ? s : endptr;
 }
 
-/// get an integer from a string
-static C_Int32 getInt32(const string &txt, bool RaiseError)
+/// get an integer from a NUL-terminated string
+static C_Int32 getInt32(const char *txt, bool RaiseError)
 {
-	const char *p = SKIP(txt.c_str());
-	char *endptr = (char*)p;
-	long int val = strtol(p, &endptr, 10);
+	const char *p = SKIP(txt);
+	C_Int64 val = 0;
+	const char *endptr = _StrToInt(p, val);
 
 	if (endptr == p)
 	{
@@ -538,16 +867,16 @@ static C_Int32 getInt32(const string &txt, bool RaiseError)
 	return val;
 }
 
-/// get multiple integers from a string
-static void getInt32Array(const string &txt, vector<C_Int32> &I32s,
-	bool RaiseError)
+/// get multiple integers from [p, end), 'end' points to a separator or NUL
+template<class TVEC> static void getInt32Array(const char *p,
+	const char *end, TVEC &I32s, bool RaiseError)
 {
-	const char *p = SKIP(txt.c_str());
+	while ((p < end) && VCF_IS_SPACE(*p)) p ++;
 	I32s.clear();
-	while (*p)
+	while (p < end)
 	{
-		char *endptr = (char*)p;
-		long int val = strtol(p, &endptr, 10);
+		C_Int64 val = 0;
+		const char *endptr = _StrToInt(p, val);
 		
 		if (endptr == p)
 		{
@@ -571,18 +900,18 @@ static void getInt32Array(const string &txt, vector<C_Int32> &I32s,
 		}
 
 		I32s.push_back(val);
-		while ((*p != 0) && (*p != ',')) p ++;
-		if (*p == ',') p ++;
+		while ((p < end) && (*p != ',')) p ++;
+		if (p < end) p ++;
 	}
 }
 
 
-/// get a real number from a string
-static double getFloat(string &txt, bool RaiseError)
+/// get a real number from a NUL-terminated string
+static double getFloat(const char *txt, bool RaiseError)
 {
-	const char *p = SKIP(txt.c_str());
-	char *endptr = (char*)p;
-	double val = strtod(p, &endptr);
+	const char *p = SKIP(txt);
+	double val = 0;
+	const char *endptr = _StrToFloat(p, val);
 	if (endptr == p)
 	{
 		if ((*p != '.') && RaiseError)
@@ -606,16 +935,16 @@ static double getFloat(string &txt, bool RaiseError)
 	return val;
 }
 
-/// get multiple real numbers from a string
-static void getFloatArray(const string &txt, vector<double> &F64s,
-	bool RaiseError)
+/// get multiple real numbers from [p, end), 'end' points to a separator or NUL
+template<class TVEC> static void getFloatArray(const char *p,
+	const char *end, TVEC &F64s, bool RaiseError)
 {
-	const char *p = SKIP(txt.c_str());
+	while ((p < end) && VCF_IS_SPACE(*p)) p ++;
 	F64s.clear();
-	while (*p)
+	while (p < end)
 	{
-		char *endptr = (char*)p;
-		double val = strtod(p, &endptr);
+		double val = 0;
+		const char *endptr = _StrToFloat(p, val);
 		if (endptr == p)
 		{
 			if ((*p != '.') && RaiseError)
@@ -628,60 +957,72 @@ static void getFloatArray(const string &txt, vector<double> &F64s,
 			p = endptr;
 
 		F64s.push_back(val);
-		while ((*p != 0) && (*p != ',')) p ++;
-		if (*p == ',') p ++;
+		while ((p < end) && (*p != ',')) p ++;
+		if (p < end) p ++;
+	}
+}
+
+/// get multiple strings from [p, end), reusing the allocated strings
+static void getStringArray(const char *p, const char *end,
+	vector<string> &UTF8s)
+{
+	while ((p < end) && ((*p == ' ') || (*p == '\t'))) p ++;
+
+	size_t n = 0;
+	while (p < end)
+	{
+		TVCF_Span val;
+		val.Ptr = p;
+		while ((p < end) && (*p != ',')) p ++;
+		val.End = p;
+		_Trim_(val);
+		if (n < UTF8s.size())
+			UTF8s[n].assign(val.Ptr, val.End);
+		else
+			_PushString(UTF8s, val);
+		n ++;
+		if (p < end) p ++;
 	}
+	UTF8s.resize(n);
 }
 
-/// get an integer from a string
-static void getStringArray(string &txt, vector<string> &UTF8s)
+/// get multiple strings from [p, end) to the values of a sample in an arena
+static void getStringArray(const char *p, const char *end,
+	CVCFArena<string>::TSlot &UTF8s)
 {
-	string val;
-	const char *p = txt.c_str();
-	while ((*p == ' ') || (*p == '\t')) p ++;
+	while ((p < end) && ((*p == ' ') || (*p == '\t'))) p ++;
 
 	UTF8s.clear();
-	while (*p)
+	while (p < end)
 	{
-		val.clear();
-		while ((*p != 0) && (*p != ','))
-			{ val.push_back(*p); p ++; }
+		TVCF_Span val;
+		val.Ptr = p;
+		while ((p < end) && (*p != ',')) p ++;
+		val.End = p;
 		_Trim_(val);
-		UTF8s.push_back(val);
-		if (*p == ',') p ++;
+		UTF8s.next().assign(val.Ptr, val.End);
+		if (p < end) p ++;
 	}
 }
 
 /// get name and value
-static const char *_GetNameValue(const char *p, string &name, string &val)
+static const char *_GetNameValue(const char *p, TVCF_Span &name,
+	TVCF_Span &val)
 {
 	// name = val
-	name.clear();
-	while ((*p != 0) && (*p != ';') && (*p != '='))
-	{
-		name.push_back(*p);
-		p ++;
-	}
+	name.Ptr = p;
+	while ((*p != 0) && (*p != ';') && (*p != '=')) p ++;
+	name.End = p;
 
-	val.clear();
 	if (*p == '=') p ++;
-	while ((*p != 0) && (*p != ';'))
-	{
-		val.push_back(*p);
-		p ++;
-	}
+	val.Ptr = p;
+	while ((*p != 0) && (*p != ';')) p ++;
+	val.End = p;
 
 	if (*p == ';') p ++;
 	return p;
 }
 
-
-extern "C"
-{
-// ===========================================================
-// Convert from VCF4: VCF4 -> GDS
-// ===========================================================
-
 /// return true, if matching
 inline static bool StrCaseCmp(const char *prefix, const char *txt)
 {
@@ -694,85 +1035,2542 @@ inline static bool StrCaseCmp(const char *prefix, const char *txt)
 	return (*prefix == 0);
 }
 
-/// VCF4 --> GDS
-COREARRAY_DLL_EXPORT SEXP SEQ_Parse_VCF4(SEXP vcf_fn, SEXP header,
-	SEXP gds_root, SEXP param, SEXP ReadLineFun, SEXP ReadLine_Param,
-	SEXP ReadLine_N, SEXP ChrPrefix, SEXP rho)
-{
-	const char *fn = CHAR(STRING_ELT(vcf_fn, 0));
 
-	// define a variable for reading lines
-	CReadLine RL;
 
-	// cell buffer
-	string cell;
-	cell.reserve(4096);
+// ===========================================================
+// the lookup table of INFO and FORMAT IDs
+// ===========================================================
 
-	COREARRAY_TRY
+/// a hash table of IDs with open addressing, built from the header
+class CVCFKeyIndex
+{
+public:
+	CVCFKeyIndex() { _mask = 0; }
 
-		// the number of calling PROTECT
-		int nProtected = 0;
+	/// build the table from a list of fields, the first one is used if
+	///   there are duplicated IDs
+	template<typename TYPE> void Init(const vector<TYPE> &list)
+	{
+		size_t n = 16;
+		while (n < 2*list.size()) n <<= 1;
+		_mask = n - 1;
+		_table.assign(n, -1);
+		_names.resize(list.size());
+		for (size_t i=0; i < list.size(); i++)
+		{
+			_names[i] = &list[i].name;
+			size_t h = Hash(list[i].name.data(), list[i].name.size()) & _mask;
+			while ((_table[h] >= 0) && (*_names[_table[h]] != list[i].name))
+				h = (h + 1) & _mask;
+			if (_table[h] < 0) _table[h] = i;
+		}
+	}
 
+	/// return the index in the list, or -1 if not found
+	COREARRAY_INLINE int Find(const TVCF_Span &key) const
+	{
+		size_t h = Hash(key.Ptr, key.Len()) & _mask;
+		int i;
+		while ((i = _table[h]) >= 0)
+		{
+			if (key.Equal(*_names[i])) return i;
+			h = (h + 1) & _mask;
+		}
+		return -1;
+	}
 
-		// =========================================================
-		// initialize variables		
+protected:
+	vector<int> _table;            //< the indices in the list, or -1
+	vector<const string*> _names;  //< the IDs in the list
+	size_t _mask;                  //< the size of table minus one
 
-		// the total number of samples
-		int nTotalSamp = Rf_asInteger(GetListElement(param, "sample.num"));
-		// the variable name for genotypic data
-		string geno_id = CHAR(STRING_ELT(GetListElement(param, "genotype.var.name"), 0));
-		// raise an error
-		bool RaiseError = (Rf_asLogical(GetListElement(param, "raise.error")) == TRUE);
-		// verbose
-		// bool Verbose = (LOGICAL(GetListElement(param, "verbose"))[0] == TRUE);
+	/// FNV-1a hash
+	inline static size_t Hash(const char *p, size_t n)
+	{
+		C_UInt32 h = 2166136261U;
+		for (; n > 0; n--, p++)
+			h = (h ^ (unsigned char)(*p)) * 16777619U;
+		return h;
+	}
+};
 
-		// the number of ploidy
-		int num_ploidy = Rf_asInteger(GetListElement(header, "num.ploidy"));
-		if (num_ploidy <= 0)
-			throw ErrSeqArray("Invalid header$num.ploidy: %d.", num_ploidy);
 
-		// filter level list
-		vector<string> filter_list;
-		{
-			SEXP level = GetListElement(param, "filter.levels");
-			if (!isNull(level))
-			{
-				for (int i=0; i < (int)XLENGTH(level); i++)
-					filter_list.push_back(CHAR(STRING_ELT(level, i)));
-			}
-		}
 
-		// GDS nodes
+// ===========================================================
+// the cells of a line
+// ===========================================================
+
+/// a class of splitting a line into tab-separated cells in place
+class CVCFCells
+{
+public:
+	CVCFCells() { _cur_char = NULL; _column_no = 0; }
+
+	/// start a new line, which will be modified
+	void Reset(char *line)
+	{
+		_cur_char = line; _column_no = 0;
+	}
+
+	/// get a cell with a seperator '\t', the separator is replaced by NUL
+	void GetCell(TVCF_Span &cell, bool last_column)
+	{
+		if (!_cur_char)
+			throw ErrSeqArray("It is the end.");
+
+		char *str_begin = _cur_char;
+		while ((*_cur_char != '\t') && (*_cur_char != 0))
+			_cur_char ++;
+		char *str_end = _cur_char;
+		_column_no ++;
+
+		// check
+		if ((str_begin == str_end) && (*_cur_char == 0))
+			throw ErrSeqArray("fewer columns than what expected.");
+		if (last_column)
+		{
+			if (*_cur_char != 0)
+				throw ErrSeqArray("more columns than what expected.");
+			_cur_char = NULL;
+		} else {
+			if (*_cur_char == '\t') _cur_char ++;
+		}
+
+		if (str_end > str_begin+1)
+		{
+			if ((str_begin[0] == '\"') && (str_end[-1] == '\"'))
+			{
+				str_begin ++;
+				str_end --;
+			} else if ((str_begin[0] == '\'') && (str_end[-1] == '\''))
+			{
+				str_begin ++;
+				str_end --;
+			}
+		}
+
+		*str_end = 0;
+		cell.Ptr = str_begin;
+		cell.End = str_end;
+	}
+
+	/// return column number
+	COREARRAY_INLINE int ColumnNo() { return _column_no; }
+
+	/// split a line like GetCell() without modifying it, used to estimate
+	///   the time of splitting, return the number of cells
+	static int Scan(const char *line)
+	{
+		int n = 0;
+		const char *p = line;
+		while (true)
+		{
+			while ((*p != '\t') && (*p != 0)) p ++;
+			n ++;
+			if (*p == 0) break;
+			p ++;
+		}
+		return n;
+	}
+
+protected:
+	char *_cur_char;        //< the current position in the line
+	int _column_no;         //< the index of current column
+};
+
+
+
+// ===========================================================
+// the structure of reading BCF2
+// ===========================================================
+
+/// the types of typed values in BCF2
+#define BCF_BT_NULL       0
+#define BCF_BT_INT8       1
+#define BCF_BT_INT16      2
+#define BCF_BT_INT32      3
+#define BCF_BT_FLOAT      5
+#define BCF_BT_CHAR       7
+
+/// the bit patterns of missing value and end-of-vector in BCF2 floats
+#define BCF_FLOAT_MISSING       0x7F800001U
+#define BCF_FLOAT_VECTOR_END    0x7F800002U
+
+/// the number of bytes of each BCF2 type, 0 for invalid types
+static const int BCF_TYPE_SIZE[8] = { 0, 1, 2, 4, 0, 4, 0, 1 };
+
+
+/// get a little-endian unsigned 32-bit integer
+inline static C_UInt32 _BCF_U32(const C_UInt8 *p)
+{
+	return (C_UInt32)p[0] | ((C_UInt32)p[1] << 8) |
+		((C_UInt32)p[2] << 16) | ((C_UInt32)p[3] << 24);
+}
+
+/// get an integer of BCF2 type, missing value is replaced by NA_INTEGER
+/** \return false for the end of vector
+**/
+inline static bool _BCF_Int(const C_UInt8 *p, int type, C_Int32 &val)
+{
+	switch (type)
+	{
+	case BCF_BT_INT8:
+		val = (C_Int8)p[0];
+		if (val == -127) return false;
+		if (val == -128) val = NA_INTEGER;
+		return true;
+	case BCF_BT_INT16:
+		val = (C_Int16)((C_UInt16)p[0] | ((C_UInt16)p[1] << 8));
+		if (val == -32767) return false;
+		if (val == -32768) val = NA_INTEGER;
+		return true;
+	case BCF_BT_INT32:
+		val = (C_Int32)_BCF_U32(p);
+		// INT_MIN is NA_INTEGER
+		return (val != INT_MIN + 1);
+	default:
+		throw ErrSeqArray("Invalid BCF integer type (%d).", type);
+	}
+}
+
+/// get a real number of BCF2 type, missing value is replaced by R_NaN
+/** \return false for the end of vector
+**/
+inline static bool _BCF_Float(const C_UInt8 *p, int type, double &val)
+{
+	if (type == BCF_BT_FLOAT)
+	{
+		C_UInt32 u = _BCF_U32(p);
+		if (u == BCF_FLOAT_VECTOR_END) return false;
+		if (u == BCF_FLOAT_MISSING)
+		{
+			val = R_NaN;
+		} else {
+			C_Float32 f;
+			memcpy(&f, &u, sizeof(f));
+			val = f;
+		}
+		return true;
+	} else {
+		C_Int32 I32;
+		if (!_BCF_Int(p, type, I32)) return false;
+		val = (I32 != NA_INTEGER) ? I32 : R_NaN;
+		return true;
+	}
+}
+
+
+/// a cursor of typed values in a BCF2 record
+struct TBCF_Cursor
+{
+	const C_UInt8 *Ptr;  //< the current position
+	const C_UInt8 *End;  //< the end of record
+
+	/// check whether there are n bytes
+	COREARRAY_INLINE void Need(size_t n) const
+	{
+		if ((size_t)(End - Ptr) < n)
+			throw ErrSeqArray("Invalid BCF record (truncated).");
+	}
+
+	/// get a type descriptor, return the type and the number of values
+	void Desc(int &type, int &num)
+	{
+		Need(1);
+		type = *Ptr & 0x0F; num = *Ptr >> 4;
+		Ptr ++;
+		if (num == 15) num = TypedInt();
+		if ((type > 7) || ((type != BCF_BT_NULL) && (BCF_TYPE_SIZE[type] == 0)))
+			throw ErrSeqArray("Invalid BCF type (%d).", type);
+		if (num < 0)
+			throw ErrSeqArray("Invalid BCF vector length (%d).", num);
+	}
+
+	/// get a typed integer, like a key or the length of a vector
+	C_Int32 TypedInt()
+	{
+		Need(1);
+		int type = *Ptr & 0x0F, num = *Ptr >> 4;
+		Ptr ++;
+		if ((num != 1) || (type < BCF_BT_INT8) || (type > BCF_BT_INT32))
+			throw ErrSeqArray("Invalid BCF typed integer.");
+		Need(BCF_TYPE_SIZE[type]);
+		C_Int32 val;
+		_BCF_Int(Ptr, type, val);
+		Ptr += BCF_TYPE_SIZE[type];
+		return val;
+	}
+
+	/// get a typed string, the padding NUL characters are removed
+	void TypedStr(TVCF_Span &s)
+	{
+		int type, num;
+		Desc(type, num);
+		if ((type != BCF_BT_CHAR) && (num > 0))
+			throw ErrSeqArray("Invalid BCF string type (%d).", type);
+		Str(num, s);
+	}
+
+	/// get num characters
+	void Str(int num, TVCF_Span &s)
+	{
+		Need(num);
+		s.Ptr = (const char*)Ptr;
+		s.End = (const char*)memchr(Ptr, 0, num);
+		if (!s.End) s.End = s.Ptr + num;
+		Ptr += num;
+	}
+
+	/// get num integers until the end of vector
+	template<class TVEC> void Ints(int type, int num, TVEC &I32s)
+	{
+		const int sz = BCF_TYPE_SIZE[type];
+		Need((size_t)sz * num);
+		I32s.clear();
+		C_Int32 val;
+		for (int i=0; i < num; i++)
+		{
+			if (!_BCF_Int(Ptr + i*sz, type, val)) break;
+			I32s.push_back(val);
+		}
+		Ptr += (size_t)sz * num;
+	}
+
+	/// get num real numbers until the end of vector
+	template<class TVEC> void Floats(int type, int num, TVEC &F64s)
+	{
+		const int sz = BCF_TYPE_SIZE[type];
+		Need((size_t)sz * num);
+		F64s.clear();
+		double val;
+		for (int i=0; i < num; i++)
+		{
+			if (!_BCF_Float(Ptr + i*sz, type, val)) break;
+			F64s.push_back(val);
+		}
+		Ptr += (size_t)sz * num;
+	}
+
+	/// skip num values
+	COREARRAY_INLINE void Skip(int type, int num)
+	{
+		Need((size_t)BCF_TYPE_SIZE[type] * num);
+		Ptr += (size_t)BCF_TYPE_SIZE[type] * num;
+	}
+};
+
+
+/// the dictionaries in the header of a BCF2 file
+struct TBCF_Header
+{
+	vector<string> Lines;    //< the lines of header text
+	vector<string> Dict;     //< the dictionary of FILTER, INFO and FORMAT IDs
+	vector<string> Contig;   //< the dictionary of contigs
+	int NumSample;           //< the number of samples in '#CHROM' line
+
+	TBCF_Header() { NumSample = 0; }
+
+	/// parse the header text
+	void Parse(const char *text)
+	{
+		Lines.clear(); Dict.clear(); Contig.clear();
+		NumSample = 0;
+		map<string, int> dict_map, contig_map;
+		// 'PASS' is always the first
+		Add(Dict, dict_map, "PASS", -1);
+
+		while (*text)
+		{
+			const char *p = text;
+			while ((*p != 0) && (*p != '\n')) p ++;
+			const char *e = p;
+			if ((e > text) && (e[-1] == '\r')) e --;
+			if (e > text)
+			{
+				Lines.push_back(string(text, e));
+				const string &s = Lines.back();
+				if ((s.compare(0, 10, "##FILTER=<") == 0) ||
+					(s.compare(0, 8, "##INFO=<") == 0) ||
+					(s.compare(0, 10, "##FORMAT=<") == 0))
+				{
+					string id = Attr(s, "ID"), idx = Attr(s, "IDX");
+					if (!id.empty())
+						Add(Dict, dict_map, id, idx.empty() ? -1 : atoi(idx.c_str()));
+				} else if (s.compare(0, 10, "##contig=<") == 0)
+				{
+					string id = Attr(s, "ID"), idx = Attr(s, "IDX");
+					if (!id.empty())
+						Add(Contig, contig_map, id, idx.empty() ? -1 : atoi(idx.c_str()));
+				} else if (s.compare(0, 6, "#CHROM") == 0)
+				{
+					int n = 0;
+					for (size_t i=0; i < s.size(); i++)
+						if (s[i] == '\t') n ++;
+					NumSample = (n > 8) ? (n - 8) : 0;
+				}
+			}
+			text = (*p == '\n') ? (p + 1) : p;
+		}
+	}
+
+	/// return the name in a dictionary
+	static const string &Name(const vector<string> &dict, C_Int32 idx)
+	{
+		if ((idx < 0) || (idx >= (C_Int32)dict.size()) || dict[idx].empty())
+			throw ErrSeqArray("Invalid BCF dictionary index (%d).", idx);
+		return dict[idx];
+	}
+
+protected:
+	/// add an ID to a dictionary, 'idx' is the position given by IDX=
+	static void Add(vector<string> &dict, map<string, int> &dict_map,
+		const string &id, int idx)
+	{
+		if (dict_map.find(id) != dict_map.end()) return;
+		if (idx < 0) idx = dict.size();
+		if (idx >= (int)dict.size()) dict.resize(idx + 1);
+		dict[idx] = id;
+		dict_map[id] = idx;
+	}
+
+	/// get the value of "<key>=" in "##XXX=<...>"
+	static string Attr(const string &s, const char *key)
+	{
+		const size_t n = strlen(key);
+		size_t i = s.find('<');
+		if (i == string::npos) return string();
+		i ++;
+		while (i < s.size())
+		{
+			// name
+			size_t st = i;
+			while ((i < s.size()) && (s[i] != '=') && (s[i] != ',') &&
+				(s[i] != '>'))
+				i ++;
+			bool match = (i-st == n) && (s.compare(st, n, key) == 0);
+			if ((i >= s.size()) || (s[i] != '='))
+			{
+				i ++; continue;
+			}
+			i ++;
+			// value
+			st = i;
+			bool quote = false;
+			while ((i < s.size()) && (quote || ((s[i] != ',') && (s[i] != '>'))))
+			{
+				if (s[i] == '\"') quote = !quote;
+				else if ((s[i] == '\\') && quote) i ++;
+				i ++;
+			}
+			if (match) return s.substr(st, i - st);
+			i ++;
+		}
+		return string();
+	}
+};
+
+
+/// a class of reading records in a BCF2 file
+class CBCFReader
+{
+public:
+	CBCFReader() { _file = NULL; _rec_no = 0; }
+	~CBCFReader()
+	{
+		if (_file) gzclose(_file);
+	}
+
+	/// open a plain or BGZF-compressed BCF2 file, and parse the header
+	void Open(const char *fn, TBCF_Header &Header)
+	{
+		_file = gzopen(fn, "rb");
+		if (!_file)
+			throw ErrSeqArray("Fail to open '%s'.", fn);
+		gzbuffer(_file, 1024*1024);
+		_rec_no = 0;
+
+		C_UInt8 magic[9];
+		if (!Read(magic, sizeof(magic)) || memcmp(magic, "BCF\2", 4) != 0)
+			throw ErrSeqArray("'%s' is not a BCF2 file.", fn);
+		C_UInt32 l_text = _BCF_U32(magic + 5);
+		vector<char> text(l_text + 1, 0);
+		if (!Read(&text[0], l_text))
+			throw ErrSeqArray("Invalid BCF header (truncated).");
+		Header.Parse(&text[0]);
+	}
+
+	/// append a record (8 bytes of lengths + data) to 'buf'
+	/** \return false for the end of file
+	**/
+	bool ReadRecord(vector<char> &buf)
+	{
+		C_UInt8 len[8];
+		int cnt = gzread(_file, len, sizeof(len));
+		if (cnt == 0) return false;
+		if (cnt != (int)sizeof(len))
+			throw ErrSeqArray("Invalid BCF record (truncated).");
+		size_t n = (size_t)_BCF_U32(len) + _BCF_U32(len + 4);
+		size_t st = buf.size();
+		buf.resize(st + sizeof(len) + n);
+		memcpy(&buf[st], len, sizeof(len));
+		if (!Read(&buf[st + sizeof(len)], n))
+			throw ErrSeqArray("Invalid BCF record (truncated).");
+		_rec_no ++;
+		return true;
+	}
+
+	/// return the index of the last record (starting from 1)
+	COREARRAY_INLINE int RecNo() const { return _rec_no; }
+
+	/// whether it is a BCF2 file
+	static bool IsBCF(const char *fn)
+	{
+		gzFile f = gzopen(fn, "rb");
+		if (!f) return false;
+		char magic[4];
+		bool rv = (gzread(f, magic, 4) == 4) && (memcmp(magic, "BCF\2", 4) == 0);
+		gzclose(f);
+		return rv;
+	}
+
+protected:
+	gzFile _file;  //< the input file
+	int _rec_no;   //< the number of records read
+
+	bool Read(void *buf, size_t n)
+	{
+		char *p = (char*)buf;
+		while (n > 0)
+		{
+			int m = (n > 0x40000000) ? 0x40000000 : (int)n;
+			int cnt = gzread(_file, p, m);
+			if (cnt < 0)
+			{
+				int err;
+				throw ErrSeqArray("Fail to read the file: %s.",
+					gzerror(_file, &err));
+			}
+			if (cnt == 0) return false;
+			p += cnt; n -= cnt;
+		}
+		return true;
+	}
+};
+
+
+
+// ===========================================================
+// the index of bgzipped VCF file (tabix or CSI)
+// ===========================================================
+
+#ifdef _WIN32
+#   define VCF_FSEEK    fseeko64
+#else
+#   define VCF_FSEEK    fseeko
+#endif
+
+/// the maximum size of a BGZF block
+#define BGZF_MAX_BLOCK_SIZE    65536
+
+
+/// a class of reading a BGZF file with random access by virtual offsets
+class CBGZFReader
+{
+public:
+	CBGZFReader()
+	{
+		_file = NULL;
+		_block_addr = _next_addr = 0;
+		_block_len = _pos = 0;
+	}
+	~CBGZFReader()
+	{
+		if (_file) fclose(_file);
+	}
+
+	/// open a BGZF file
+	void Open(const char *fn)
+	{
+		_file = fopen(fn, "rb");
+		if (!_file)
+			throw ErrSeqArray("Fail to open '%s'.", fn);
+		_cdata.resize(BGZF_MAX_BLOCK_SIZE);
+		_udata.resize(BGZF_MAX_BLOCK_SIZE);
+		_block_addr = _next_addr = 0;
+		_block_len = _pos = 0;
+	}
+
+	/// move to a virtual offset (the block address << 16 | the offset)
+	void Seek(C_UInt64 voffset)
+	{
+		C_UInt64 addr = voffset >> 16;
+		int pos = voffset & 0xFFFF;
+		if (addr != _block_addr || _block_len == 0)
+		{
+			if (VCF_FSEEK(_file, addr, SEEK_SET) != 0)
+				throw ErrSeqArray("Fail to seek the BGZF file.");
+			_next_addr = addr;
+			if (!LoadBlock())
+				throw ErrSeqArray("Invalid virtual offset in the index.");
+		}
+		if (pos > _block_len)
+			throw ErrSeqArray("Invalid virtual offset in the index.");
+		_pos = pos;
+	}
+
+	/// the virtual offset of the current position
+	COREARRAY_INLINE C_UInt64 Tell() const
+	{
+		return (_block_addr << 16) | (C_UInt64)_pos;
+	}
+
+	/// read a line without '\n', return false at the end of file
+	bool ReadLine(string &line)
+	{
+		line.clear();
+		bool any = false;
+		while (true)
+		{
+			if (_pos >= _block_len)
+			{
+				if (!LoadBlock()) return any;
+				if (_block_len == 0) continue;
+			}
+			any = true;
+			const char *s = &_udata[_pos];
+			const char *p = (const char*)memchr(s, '\n', _block_len - _pos);
+			if (p)
+			{
+				line.append(s, p);
+				_pos += (p - s) + 1;
+				if (!line.empty() && (line[line.size()-1] == '\r'))
+					line.resize(line.size() - 1);
+				return true;
+			}
+			line.append(s, _block_len - _pos);
+			_pos = _block_len;
+		}
+	}
+
+protected:
+	FILE *_file;            //< the file
+	C_UInt64 _block_addr;   //< the file offset of the current block
+	C_UInt64 _next_addr;    //< the file offset of the next block
+	vector<C_UInt8> _cdata; //< the compressed block
+	vector<char> _udata;    //< the uncompressed block
+	int _block_len;         //< the number of bytes in '_udata'
+	int _pos;               //< the current position in '_udata'
+
+	/// load the next block, return false at the end of file
+	bool LoadBlock()
+	{
+		C_UInt8 *h = &_cdata[0];
+		size_t n = fread(h, 1, 12, _file);
+		if (n == 0) return false;
+		if ((n != 12) || (h[0] != 31) || (h[1] != 139) || (h[2] != 8) ||
+				!(h[3] & 4))
+			throw ErrSeqArray("Invalid BGZF block, the file should be bgzipped.");
+		int xlen = h[10] | (h[11] << 8);
+		if (fread(h + 12, 1, xlen, _file) != (size_t)xlen)
+			throw ErrSeqArray("Invalid BGZF block (truncated).");
+		// find the subfield 'BC'
+		int bsize = -1;
+		for (int i=12; i+4 <= 12+xlen; )
+		{
+			int slen = h[i+2] | (h[i+3] << 8);
+			if ((h[i] == 'B') && (h[i+1] == 'C') && (slen == 2))
+				bsize = h[i+4] | (h[i+5] << 8);
+			i += 4 + slen;
+		}
+		if ((bsize < 0) || (bsize+1 < 12+xlen+8))
+			throw ErrSeqArray("Invalid BGZF block, the file should be bgzipped.");
+		int rest = bsize + 1 - 12 - xlen;
+		if (fread(h + 12 + xlen, 1, rest, _file) != (size_t)rest)
+			throw ErrSeqArray("Invalid BGZF block (truncated).");
+
+		// inflate
+		const C_UInt8 *tail = h + bsize + 1 - 4;
+		C_UInt32 isize = _BCF_U32(tail);
+		if (isize > BGZF_MAX_BLOCK_SIZE)
+			throw ErrSeqArray("Invalid BGZF block size.");
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		zs.next_in = h + 12 + xlen;
+		zs.avail_in = rest - 8;
+		zs.next_out = (Bytef*)&_udata[0];
+		zs.avail_out = _udata.size();
+		if (inflateInit2(&zs, -15) != Z_OK)
+			throw ErrSeqArray("Fail to initialize zlib.");
+		int rv = inflate(&zs, Z_FINISH);
+		inflateEnd(&zs);
+		if ((rv != Z_STREAM_END) || (zs.total_out != isize))
+			throw ErrSeqArray("Fail to inflate the BGZF block.");
+
+		_block_addr = _next_addr;
+		_next_addr += bsize + 1;
+		_block_len = isize;
+		_pos = 0;
+		return true;
+	}
+};
+
+
+/// a chunk of virtual offsets [Beg, End) in the index
+struct TVCF_IndexChunk
+{
+	C_UInt64 Beg;
+	C_UInt64 End;
+
+	bool operator< (const TVCF_IndexChunk &v) const { return Beg < v.Beg; }
+};
+
+
+/// a class of the tabix (.tbi) or CSI (.csi) index of a bgzipped VCF file
+class CVCFIndex
+{
+public:
+	vector<string> Names;   //< the sequence names
+
+	/// load 'fn.tbi' or 'fn.csi'
+	void Load(const char *fn)
+	{
+		vector<C_UInt8> buf;
+		if (!ReadFile((string(fn) + ".tbi").c_str(), buf) &&
+				!ReadFile((string(fn) + ".csi").c_str(), buf))
+			throw ErrSeqArray("No tabix (.tbi) or CSI (.csi) index for '%s'.", fn);
+
+		TBCF_Cursor R;
+		R.Ptr = &buf[0]; R.End = R.Ptr + buf.size();
+		R.Need(4);
+		if (memcmp(R.Ptr, "TBI\1", 4) == 0)
+		{
+			R.Ptr += 4;
+			_is_csi = false;
+			_min_shift = 14; _depth = 5;
+			int n_ref = I32(R);
+			TabixHeader(R);
+			Refs.resize(n_ref);
+			for (int i=0; i < n_ref; i++)
+			{
+				TRef &Ref = Refs[i];
+				LoadBins(R, Ref);
+				int n_intv = I32(R);
+				R.Need((size_t)8 * n_intv);
+				Ref.Linear.resize(n_intv);
+				for (int j=0; j < n_intv; j++)
+					Ref.Linear[j] = U64(R);
+			}
+		} else if (memcmp(R.Ptr, "CSI\1", 4) == 0)
+		{
+			R.Ptr += 4;
+			_is_csi = true;
+			_min_shift = I32(R); _depth = I32(R);
+			int l_aux = I32(R);
+			R.Need(l_aux);
+			if (l_aux < 28)
+				throw ErrSeqArray("The CSI index of '%s' is not for a VCF file.", fn);
+			TBCF_Cursor A;
+			A.Ptr = R.Ptr; A.End = R.Ptr + l_aux;
+			TabixHeader(A);
+			R.Ptr += l_aux;
+			int n_ref = I32(R);
+			Refs.resize(n_ref);
+			for (int i=0; i < n_ref; i++)
+				LoadBins(R, Refs[i]);
+		} else
+			throw ErrSeqArray("Invalid index file of '%s'.", fn);
+		if (Refs.size() > Names.size())
+			throw ErrSeqArray("Invalid index file of '%s'.", fn);
+	}
+
+	/// return the index of a sequence name, or -1 if not found
+	int SeqIndex(const string &name) const
+	{
+		vector<string>::const_iterator it =
+			std::find(Names.begin(), Names.end(), name);
+		return (it != Names.end()) ? (it - Names.begin()) : -1;
+	}
+
+	/// get the sorted and merged chunks overlapping [beg, end), 0-based
+	void Query(int tid, C_Int64 beg, C_Int64 end,
+		vector<TVCF_IndexChunk> &out) const
+	{
+		out.clear();
+		if ((tid < 0) || (tid >= (int)Refs.size())) return;
+		const TRef &Ref = Refs[tid];
+		C_Int64 max_len = (C_Int64)1 << (_min_shift + 3*_depth);
+		if (beg < 0) beg = 0;
+		if (end > max_len) end = max_len;
+		if (beg >= end) return;
+
+		// the minimum offset of records overlapping 'beg'
+		C_UInt64 min_off = 0;
+		if (_is_csi)
+		{
+			C_UInt32 bin = BinFirst(_depth) + (beg >> _min_shift);
+			while (true)
+			{
+				map<C_UInt32, C_UInt64>::const_iterator it = Ref.LOffset.find(bin);
+				if (it != Ref.LOffset.end())
+				{
+					min_off = it->second;
+					break;
+				}
+				if (bin == 0) break;
+				bin = (bin - 1) >> 3;
+			}
+		} else if (!Ref.Linear.empty())
+		{
+			C_Int64 i = beg >> _min_shift;
+			if (i >= (C_Int64)Ref.Linear.size()) i = Ref.Linear.size() - 1;
+			min_off = Ref.Linear[i];
+		}
+
+		// the bins overlapping [beg, end)
+		C_Int64 e = end - 1;
+		int s = _min_shift + 3*_depth;
+		for (int l=0, t=0; l <= _depth; l++)
+		{
+			for (C_Int64 b = t + (beg >> s); b <= t + (e >> s); b++)
+			{
+				map<C_UInt32, vector<TVCF_IndexChunk> >::const_iterator it =
+					Ref.Bins.find(b);
+				if (it == Ref.Bins.end()) continue;
+				for (size_t j=0; j < it->second.size(); j++)
+				{
+					if (it->second[j].End > min_off)
+						out.push_back(it->second[j]);
+				}
+			}
+			t += 1 << (3*l);
+			s -= 3;
+		}
+
+		// merge
+		std::sort(out.begin(), out.end());
+		size_t n = 0;
+		for (size_t i=0; i < out.size(); i++)
+		{
+			if ((n > 0) && (out[i].Beg <= out[n-1].End))
+			{
+				if (out[i].End > out[n-1].End)
+					out[n-1].End = out[i].End;
+			} else
+				out[n++] = out[i];
+		}
+		out.resize(n);
+	}
+
+protected:
+	struct TRef
+	{
+		map<C_UInt32, vector<TVCF_IndexChunk> > Bins;  //< the chunks in bins
+		map<C_UInt32, C_UInt64> LOffset;  //< the minimum offsets of CSI bins
+		vector<C_UInt64> Linear;          //< the linear index of tabix
+	};
+
+	vector<TRef> Refs;   //< the index of each sequence
+	int _min_shift;      //< the number of bits of the minimum bin
+	int _depth;          //< the number of levels of bins
+	bool _is_csi;        //< true for CSI, false for tabix
+
+	inline static C_UInt32 BinFirst(int l)
+		{ return ((1 << (3*l)) - 1) / 7; }
+
+	inline static C_Int32 I32(TBCF_Cursor &R)
+	{
+		R.Need(4);
+		C_Int32 v = (C_Int32)_BCF_U32(R.Ptr);
+		R.Ptr += 4;
+		return v;
+	}
+
+	inline static C_UInt64 U64(TBCF_Cursor &R)
+	{
+		R.Need(8);
+		C_UInt64 v = _BCF_U32(R.Ptr) | ((C_UInt64)_BCF_U32(R.Ptr + 4) << 32);
+		R.Ptr += 8;
+		return v;
+	}
+
+	/// the tabix header: format, columns, meta, skip and sequence names
+	void TabixHeader(TBCF_Cursor &R)
+	{
+		C_Int32 format = I32(R);
+		I32(R); I32(R); I32(R); I32(R); I32(R);  // col_seq ... skip
+		if ((format & 0xFFFF) != 2)
+			throw ErrSeqArray("The index is not for a VCF file.");
+		int l_nm = I32(R);
+		R.Need(l_nm);
+		Names.clear();
+		const char *p = (const char*)R.Ptr, *end = p + l_nm;
+		while (p < end)
+		{
+			const char *s = p;
+			while ((p < end) && (*p != 0)) p ++;
+			Names.push_back(string(s, p));
+			p ++;
+		}
+		R.Ptr += l_nm;
+	}
+
+	/// the binning index of a sequence
+	void LoadBins(TBCF_Cursor &R, TRef &Ref)
+	{
+		int n_bin = I32(R);
+		for (int i=0; i < n_bin; i++)
+		{
+			C_UInt32 bin = I32(R);
+			if (_is_csi) Ref.LOffset[bin] = U64(R);
+			int n_chunk = I32(R);
+			vector<TVCF_IndexChunk> &C = Ref.Bins[bin];
+			C.resize(n_chunk);
+			for (int j=0; j < n_chunk; j++)
+			{
+				C[j].Beg = U64(R);
+				C[j].End = U64(R);
+			}
+		}
+	}
+
+	/// read a BGZF-compressed index file
+	static bool ReadFile(const char *fn, vector<C_UInt8> &buf)
+	{
+		gzFile f = gzopen(fn, "rb");
+		if (!f) return false;
+		buf.clear();
+		C_UInt8 tmp[65536];
+		int n;
+		while ((n = gzread(f, tmp, sizeof(tmp))) > 0)
+			buf.insert(buf.end(), tmp, tmp + n);
+		gzclose(f);
+		if (n < 0)
+			throw ErrSeqArray("Fail to read '%s'.", fn);
+		return !buf.empty();
+	}
+};
+
+
+/// a genomic region, 1-based and inclusive
+struct TVCF_Region
+{
+	int Tid;        //< the index of sequence in the index
+	C_Int64 Beg;    //< the start position
+	C_Int64 End;    //< the end position
+
+	bool operator< (const TVCF_Region &v) const
+		{ return (Tid < v.Tid) || ((Tid == v.Tid) && (Beg < v.Beg)); }
+};
+
+
+/// a class of reading the lines of a bgzipped VCF file in regions
+class CVCFRegionReader
+{
+public:
+	CVCFRegionReader() { _reg_idx = _chunk_idx = 0; _line_no = 0; }
+
+	/// open the file and its index, 'beg' and 'end' are 1-based
+	void Init(const char *fn, const vector<string> &chr,
+		const vector<C_Int64> &beg, const vector<C_Int64> &end)
+	{
+		_index.Load(fn);
+		_file.Open(fn);
+		_regions.clear();
+		for (size_t i=0; i < chr.size(); i++)
+		{
+			TVCF_Region R;
+			R.Tid = _index.SeqIndex(chr[i]);
+			R.Beg = beg[i]; R.End = end[i];
+			if ((R.Tid >= 0) && (R.Beg <= R.End))
+				_regions.push_back(R);
+		}
+		// sort and merge
+		std::sort(_regions.begin(), _regions.end());
+		size_t n = 0;
+		for (size_t i=0; i < _regions.size(); i++)
+		{
+			if ((n > 0) && (_regions[i].Tid == _regions[n-1].Tid) &&
+				(_regions[i].Beg <= _regions[n-1].End + 1))
+			{
+				if (_regions[i].End > _regions[n-1].End)
+					_regions[n-1].End = _regions[i].End;
+			} else
+				_regions[n++] = _regions[i];
+		}
+		_regions.resize(n);
+		_reg_idx = -1;
+		_chunk_idx = 0;
+		_chunks.clear();
+		_line_no = 0;
+	}
+
+	/// read a line in the regions, return NULL if no more line
+	const char *ReadLine()
+	{
+		while (true)
+		{
+			if (_chunk_idx >= (int)_chunks.size())
+			{
+				// the next region
+				if (++_reg_idx >= (int)_regions.size()) return NULL;
+				const TVCF_Region &R = _regions[_reg_idx];
+				_index.Query(R.Tid, R.Beg - 1, R.End, _chunks);
+				_chunk_idx = 0;
+				if (!_chunks.empty() && (_file.Tell() != _chunks[0].Beg))
+					_file.Seek(_chunks[0].Beg);
+				continue;
+			}
+
+			if ((_file.Tell() >= _chunks[_chunk_idx].End) || !_file.ReadLine(_line))
+			{
+				// the next chunk
+				if (++_chunk_idx < (int)_chunks.size())
+				{
+					if (_file.Tell() < _chunks[_chunk_idx].Beg)
+						_file.Seek(_chunks[_chunk_idx].Beg);
+				}
+				continue;
+			}
+			if (_line.empty() || (_line[0] == '#')) continue;
+
+			// check the position
+			const TVCF_Region &R = _regions[_reg_idx];
+			C_Int64 pos, pos_end;
+			if (!Position(_line, R.Tid, pos, pos_end) || (pos > R.End))
+			{
+				// no more record in the region
+				_chunk_idx = _chunks.size();
+				continue;
+			}
+			if (pos_end < R.Beg) continue;
+			// not in the previous region
+			if ((_reg_idx > 0) && (_regions[_reg_idx-1].Tid == R.Tid) &&
+					(pos <= _regions[_reg_idx-1].End))
+				continue;
+
+			_line_no ++;
+			return _line.c_str();
+		}
+	}
+
+	/// return the number of lines read
+	COREARRAY_INLINE int LineNo() { return _line_no; }
+
+protected:
+	CVCFIndex _index;                 //< the index
+	CBGZFReader _file;                //< the bgzipped VCF file
+	vector<TVCF_Region> _regions;     //< the sorted regions without overlap
+	vector<TVCF_IndexChunk> _chunks;  //< the chunks of the current region
+	int _reg_idx;      //< the index of the current region
+	int _chunk_idx;    //< the index of the current chunk
+	string _line;      //< the current line
+	int _line_no;      //< the number of lines returned
+
+	/// get the position and the end position of a record, return false
+	///   if it is not on the sequence 'tid'
+	bool Position(const string &line, int tid, C_Int64 &pos, C_Int64 &end)
+	{
+		const char *p = line.c_str();
+		const string &chr = _index.Names[tid];
+		if ((line.compare(0, chr.size(), chr) != 0) || (p[chr.size()] != '\t'))
+			return false;
+		p += chr.size() + 1;
+		p = _StrToInt(p, pos);
+		// the length of REF
+		for (int i=0; (i < 2) && *p; i++)
+		{
+			while ((*p != 0) && (*p != '\t')) p ++;
+			if (*p == '\t') p ++;
+		}
+		const char *s = p;
+		while ((*p != 0) && (*p != '\t')) p ++;
+		end = pos + (p - s) - 1;
+		if (end < pos) end = pos;
+		// END= in the INFO column
+		for (int i=0; (i < 4) && *p; i++)
+		{
+			if (*p == '\t') p ++;
+			s = p;
+			while ((*p != 0) && (*p != '\t')) p ++;
+		}
+		while (s < p)
+		{
+			if (strncmp(s, "END=", 4) == 0)
+			{
+				C_Int64 v;
+				if (_StrToInt(s + 4, v) != s + 4) end = v;
+				break;
+			}
+			while ((s < p) && (*s != ';')) s ++;
+			if (s < p) s ++;
+		}
+		return true;
+	}
+};
+
+
+// ===========================================================
+// a batch of lines and the parsed values
+// ===========================================================
+
+/// the number of lines read at a time per parsing thread
+#define VCF_BATCH_LINE      1024
+/// the number of bytes read at a time per parsing thread
+#define VCF_BATCH_BYTE      (4*1024*1024)
+/// the number of variants staged in the writer before appending to GDS
+#define VCF_FLUSH_VARIANT   8192
+/// the number of genotype bytes staged in the writer before appending to GDS
+#define VCF_FLUSH_BYTE      (16*1024*1024)
+/// the interval of reporting the progress, in seconds
+#define VCF_PROGRESS_SECOND 30
+/// one of the lines is split again to time the splitting of cells
+#define VCF_SAMPLE_LINE     32
+
+
+/// the columns parsed from contiguous lines, appended by the writer
+struct TVCF_Slice
+{
+	int Start;     //< the first line in the batch
+	int Count;     //< the number of lines
+
+	vector<string> Chr, RSID, Allele, Filter;
+	vector<C_Int32> Pos;
+	vector<C_Float64> Qual;
+
+	vector<C_Int8> Geno;           //< the bit planes of genotypes
+	vector<C_Int32> GenoLen;       //< genotype/@data
+	vector<C_Int32> GenoExtra;     //< genotype/extra
+	vector<C_Int32> GenoExtraIdx;  //< genotype/extra.index
+	vector<C_Int32> Phase;         //< phase/data
+	vector<C_Int32> PhaseExtra;    //< phase/extra
+	vector<C_Int32> PhaseExtraIdx; //< phase/extra.index
+
+	vector<TVCF_Field_Buffer> Info;    //< INFO fields
+	vector<TVCF_Field_Buffer> Format;  //< FORMAT fields
+
+	vector<string> Warning;        //< warnings with line numbers
+	set<string> InfoMissing;       //< unknown INFO IDs
+	set<string> FormatMissing;     //< unknown FORMAT IDs
+
+	bool HasError;     //< whether an error occurs
+	string ErrMsg;     //< the error message
+	int ErrLine;       //< the line number of error
+	int ErrColumn;     //< the column number of error
+	string ErrCell;    //< the cell of error
+
+	void Clear(size_t nInfo, size_t nFormat)
+	{
+		Start = Count = 0;
+		Chr.clear(); RSID.clear(); Allele.clear(); Filter.clear();
+		Pos.clear(); Qual.clear();
+		Geno.clear(); GenoLen.clear(); GenoExtra.clear(); GenoExtraIdx.clear();
+		Phase.clear(); PhaseExtra.clear(); PhaseExtraIdx.clear();
+		Info.resize(nInfo);
+		for (size_t i=0; i < nInfo; i++) Info[i].Clear();
+		Format.resize(nFormat);
+		for (size_t i=0; i < nFormat; i++) Format[i].Clear();
+		Warning.clear(); InfoMissing.clear(); FormatMissing.clear();
+		HasError = false; ErrMsg.clear();
+		ErrLine = ErrColumn = 0; ErrCell.clear();
+	}
+
+	/// append the parsed values of another slice, except warnings and errors
+	void Append(const TVCF_Slice &S)
+	{
+		Count += S.Count;
+		_Concat(Chr, S.Chr); _Concat(RSID, S.RSID);
+		_Concat(Allele, S.Allele); _Concat(Filter, S.Filter);
+		_Concat(Pos, S.Pos); _Concat(Qual, S.Qual);
+		_Concat(Geno, S.Geno); _Concat(GenoLen, S.GenoLen);
+		_Concat(GenoExtra, S.GenoExtra); _Concat(GenoExtraIdx, S.GenoExtraIdx);
+		_Concat(Phase, S.Phase); _Concat(PhaseExtra, S.PhaseExtra);
+		_Concat(PhaseExtraIdx, S.PhaseExtraIdx);
+		for (size_t i=0; i < Info.size(); i++) Info[i].Append(S.Info[i]);
+		for (size_t i=0; i < Format.size(); i++) Format[i].Append(S.Format[i]);
+	}
+};
+
+
+/// a batch of lines split into slices
+struct TVCF_Batch
+{
+	vector<char> Text;           //< the text of lines, NUL-terminated
+	vector<size_t> LineOffset;   //< the start of each line in Text
+	vector<int> LineNo;          //< the line number of each line
+	C_Int32 VariantBase;         //< the variant id before the first line
+	vector<TVCF_Slice> Slices;   //< the parsed values
+
+	COREARRAY_INLINE int NumLine() const { return LineOffset.size(); }
+	COREARRAY_INLINE char *Line(int i) { return &Text[LineOffset[i]]; }
+	COREARRAY_INLINE size_t LineSize(int i) const
+	{
+		return ((i+1 < NumLine()) ? LineOffset[i+1] : Text.size()) -
+			LineOffset[i];
+	}
+
+	/// read up to nLine lines or nByte bytes
+	void Read(CReadLine &RL, int nLine, size_t nByte, C_Int32 &variant_index)
+	{
+		Text.clear(); LineOffset.clear(); LineNo.clear();
+		VariantBase = variant_index;
+		while ((NumLine() < nLine) && (Text.size() < nByte) && !RL.IfEnd())
+		{
+			const char *p = RL.ReadLine();
+			LineOffset.push_back(Text.size());
+			LineNo.push_back(RL.LineNo());
+			Text.insert(Text.end(), p, p + strlen(p) + 1);
+		}
+		variant_index += NumLine();
+	}
+
+	/// read up to nLine lines in the regions or nByte bytes
+	void Read(CVCFRegionReader &RR, int nLine, size_t nByte,
+		C_Int32 &variant_index)
+	{
+		Text.clear(); LineOffset.clear(); LineNo.clear();
+		VariantBase = variant_index;
+		const char *p;
+		while ((NumLine() < nLine) && (Text.size() < nByte) &&
+			(p = RR.ReadLine()))
+		{
+			LineOffset.push_back(Text.size());
+			LineNo.push_back(RR.LineNo());
+			Text.insert(Text.end(), p, p + strlen(p) + 1);
+		}
+		variant_index += NumLine();
+	}
+
+	/// read up to nRec BCF2 records or nByte bytes
+	void Read(CBCFReader &BR, int nRec, size_t nByte, C_Int32 &variant_index)
+	{
+		Text.clear(); LineOffset.clear(); LineNo.clear();
+		VariantBase = variant_index;
+		while ((NumLine() < nRec) && (Text.size() < nByte))
+		{
+			size_t st = Text.size();
+			if (!BR.ReadRecord(Text)) break;
+			LineOffset.push_back(st);
+			LineNo.push_back(BR.RecNo());
+		}
+		variant_index += NumLine();
+	}
+
+	/// split lines into slices
+	void Split(int nSlice, size_t nInfo, size_t nFormat)
+	{
+		Slices.resize(nSlice);
+		const int n = NumLine();
+		for (int i=0; i < nSlice; i++)
+		{
+			TVCF_Slice &S = Slices[i];
+			S.Clear(nInfo, nFormat);
+			S.Start = (C_Int64)n * i / nSlice;
+			S.Count = (C_Int64)n * (i+1) / nSlice - S.Start;
+		}
+	}
+};
+
+
+
+// ===========================================================
+// the parser of lines
+// ===========================================================
+
+/// the options of parsing shared by all parsers
+struct TVCF_Option
+{
+	int nTotalSamp;        //< the total number of samples
+	string geno_id;        //< the variable name for genotypic data
+	bool RaiseError;       //< raise an error or not
+	int num_ploidy;        //< the number of ploidy
+	int GenoNumBits;       //< the number of bits in genotype/data
+	int GenoBitMask;       //< the bit mask of genotype/data
+	bool HasPhase;         //< whether phase/data exists
+	vector<string> ChrPref;  //< the prefix of chromosome to be removed
+};
+
+
+/// a class of parsing VCF lines into columns, used by one thread
+class CVCFParser
+{
+public:
+	CVCFParser(const TVCF_Option &opt, const vector<TVCF_Field_Info> &info,
+		const vector<TVCF_Field_Format> &fmt):
+		Opt(opt), info_list(info), format_list(fmt)
+	{
+		I32s.reserve(Opt.nTotalSamp);
+		F64s.reserve(Opt.nTotalSamp);
+		StrList.reserve(Opt.nTotalSamp);
+		Geno.Init(Opt.nTotalSamp, Opt.num_ploidy);
+		fmt_ptr.reserve(format_list.size());
+		info_index.Init(info_list);
+		format_index.Init(format_list);
+		fmt_cache_valid = false;
+		IsText = true;
+		LineTime = PackTime = 0;
+		ScanTime = 0;
+		ScanBytes = TotalBytes = 0;
+		ScanCells = 0;
+		_line_cnt = 0;
+	}
+
+	virtual ~CVCFParser() { }
+
+	/// the seconds of splitting cells, estimated from the sampled lines
+	double TokenizeTime() const
+	{
+		return (ScanBytes > 0) ? (ScanTime * TotalBytes / ScanBytes) : 0;
+	}
+	/// the seconds of parsing lines, excluding splitting cells and packing
+	double ParseTime() const
+	{
+		double t = LineTime - PackTime - TokenizeTime();
+		return (t > 0) ? t : 0;
+	}
+	/// the seconds of packing genotypes and staging FORMAT values
+	double PackingTime() const { return PackTime; }
+
+	/// parse the lines of a slice in place, errors are saved in the slice
+	void Parse(TVCF_Batch &Batch, TVCF_Slice &Out)
+	{
+		// unknown FORMAT IDs are reported in each slice
+		fmt_cache_valid = false;
+		int i = Out.Start;
+		double t0 = VCF_Now();
+		try {
+			for (; i < Out.Start + Out.Count; i++)
+			{
+				const size_t size = Batch.LineSize(i);
+				TotalBytes += size;
+				if (IsText && ((++_line_cnt) % VCF_SAMPLE_LINE == 0))
+				{
+					// time the splitting of this line
+					ScanCells += CVCFCells::Scan(Batch.Line(i));
+					double t1 = VCF_Now();
+					ScanTime += t1 - t0;
+					ScanBytes += size;
+					t0 = t1;
+				}
+				ParseLine(Batch.Line(i), Batch.LineNo[i],
+					Batch.VariantBase + i + 1, Out);
+				double t1 = VCF_Now();
+				LineTime += t1 - t0;
+				t0 = t1;
+			}
+		} catch (ErrCoreArray &E) {
+			SetError(Out, E.what(), Batch.LineNo[i]);
+		} catch (std::exception &E) {
+			SetError(Out, E.what(), Batch.LineNo[i]);
+		} catch (...) {
+			SetError(Out, "unknown error.", Batch.LineNo[i]);
+		}
+	}
+
+protected:
+	const TVCF_Option &Opt;
+	vector<TVCF_Field_Info> info_list;     //< a copy with its own 'used'
+	vector<TVCF_Field_Format> format_list; //< a copy with its own buffers
+	CVCFKeyIndex info_index;     //< the hash table of INFO IDs
+	CVCFKeyIndex format_index;   //< the hash table of FORMAT IDs
+	string fmt_cache;            //< the FORMAT column of 'fmt_ptr'
+	bool fmt_cache_valid;        //< whether 'fmt_cache' is valid
+	CVCFCells Cells;
+	bool IsText;        //< false if the lines are binary BCF2 records
+
+	// the timing counters in seconds
+	double LineTime;    //< parsing lines, including packing
+	double PackTime;    //< packing genotypes and staging FORMAT values
+	double ScanTime;    //< splitting the sampled lines into cells
+	double ScanBytes, TotalBytes;  //< the sizes of sampled and all lines
+	C_Int64 ScanCells;  //< the number of cells in the sampled lines
+	int _line_cnt;
+
+	// the spans in the line
+	TVCF_Span cell, name, value;
+	// the numeric buffer
+	vector<C_Int32> I32s;
+	vector<C_Float64> F64s;
+	// the string buffer
+	vector<string> StrList;
+	// genotypes
+	CVCFArena<C_Int16> Geno;
+	vector< TVCF_Field_Format* > fmt_ptr;
+
+	void SetError(TVCF_Slice &Out, const char *msg, int line_no)
+	{
+		Out.HasError = true;
+		Out.ErrMsg = msg;
+		Out.ErrLine = line_no;
+		Out.ErrColumn = Cells.ColumnNo();
+		Out.ErrCell = cell.Str();
+	}
+
+	/// remove the prefix of chromosome
+	void ChrPrefix(TVCF_Span &chr)
+	{
+		vector<string>::const_iterator it = Opt.ChrPref.begin();
+		for (; it != Opt.ChrPref.end(); it++)
+		{
+			if (StrCaseCmp(it->c_str(), chr.Ptr))
+			{
+				chr.Ptr += it->size();
+				break;
+			}
+		}
+	}
+
+	/// the number of alleles in "REF,ALT1,ALT2,..."
+	static int NumAllele(const string &allele)
+	{
+		int num_allele = 0;
+		const char *p = allele.c_str();
+		while (*p != 0)
+		{
+			num_allele ++;
+			while ((*p != 0) && (*p != ',')) p ++;
+			if (*p == ',') p ++;
+		}
+		return num_allele;
+	}
+
+	/// fill the INFO fields which do not exist in the current line
+	void FillInfo(TVCF_Slice &Out)
+	{
+		vector<TVCF_Field_Info>::iterator pInfo;
+		for (pInfo = info_list.begin(); pInfo != info_list.end(); pInfo++)
+		{
+			if (!pInfo->used && pInfo->import_flag)
+			{
+				TVCF_Field_Buffer &buf = Out.Info[pInfo - info_list.begin()];
+				switch (pInfo->type)
+				{
+				case FIELD_TYPE_INT:
+					pInfo->Fill((C_Int32)NA_INTEGER, buf);
+					break;
+				case FIELD_TYPE_FLOAT:
+					pInfo->Fill((double)R_NaN, buf);
+					break;
+				case FIELD_TYPE_FLAG:
+					buf.I32.push_back(0);
+					break;
+				case FIELD_TYPE_STRING:
+					pInfo->Fill(string(), buf);
+					break;
+				default:
+					throw ErrSeqArray("Invalid INFO Type.");
+				}
+				pInfo->used = true;
+			}
+		}
+	}
+
+	/// check the alleles in Geno[samp_idx] and the phases in I32s
+	void SetSampleGeno(int samp_idx, C_Int32 variant_index, TVCF_Slice &Out)
+	{
+		const int num_ploidy = Opt.num_ploidy;
+
+		// check pAllele
+		CVCFArena<C_Int16>::TSlot pAllele = Geno[samp_idx];
+		if ((int)pAllele.size() < num_ploidy)
+			pAllele.resize(num_ploidy, -1);
+
+		if (Opt.HasPhase)
+		{
+			// write phasing information
+			if ((int)I32s.size() < (num_ploidy-1))
+				I32s.resize(num_ploidy-1, 0);
+			Out.Phase.insert(Out.Phase.end(), I32s.begin(),
+				I32s.begin() + (num_ploidy-1));
+			if ((int)I32s.size() > (num_ploidy-1))
+			{
+				// E.g., triploid call: 0/0/1
+				int Len = (int)I32s.size() - (num_ploidy-1);
+				Out.PhaseExtra.insert(Out.PhaseExtra.end(),
+					I32s.begin() + (num_ploidy-1), I32s.end());
+				Out.PhaseExtraIdx.push_back(samp_idx + 1);
+				Out.PhaseExtraIdx.push_back(variant_index);
+				Out.PhaseExtraIdx.push_back(Len);
+			}
+		}
+	}
+
+	/// write the genotypes and the FORMAT fields of the current line
+	void WriteGenoFormat(int num_allele, C_Int32 variant_index,
+		TVCF_Slice &Out)
+	{
+		const double t0 = VCF_Now();
+		const int nTotalSamp = Opt.nTotalSamp;
+		const int num_ploidy = Opt.num_ploidy;
+		C_Int32 I32;
+
+		// determine how many bits (GenoNumBits == 2, 4 or 8)
+		int num_bits = Opt.GenoNumBits;
+		// plus ONE for missing value
+		while ((num_allele + 1) > (1 << num_bits))
+			num_bits += Opt.GenoNumBits;
+		Out.GenoLen.push_back(num_bits / Opt.GenoNumBits);
+
+		// write to the variable "genotype"
+		for (int bits=0; bits < num_bits; bits += Opt.GenoNumBits)
+		{
+			for (int i=0; i < nTotalSamp; i++)
+			{
+				const C_Int16 *pAllele = Geno.Ptr(i);
+				for (int j=0; j < num_ploidy; j++)
+					Out.Geno.push_back((pAllele[j] >> bits) & Opt.GenoBitMask);
+			}
+		}
+
+		// write to "genotype/extra"
+		for (int i=0; i < nTotalSamp; i++)
+		{
+			if (Geno.Num(i) > num_ploidy)
+			{
+				// E.g., triploid call: 0/0/1
+				int Len = Geno.Num(i) - num_ploidy;
+				const C_Int16 *pGeno = Geno.Ptr(i) + num_ploidy;
+				Out.GenoExtra.insert(Out.GenoExtra.end(), pGeno, pGeno + Len);
+				Out.GenoExtraIdx.push_back(i + 1);
+				Out.GenoExtraIdx.push_back(variant_index);
+				Out.GenoExtraIdx.push_back(Len);
+			}
+		}
+
+		// for-loop all format IDs: write
+		for (vector<TVCF_Field_Format>::iterator it = format_list.begin();
+			it != format_list.end(); it++)
+		{
+			if (it->import_flag)
+			{
+				TVCF_Field_Buffer &buf = Out.Format[it - format_list.begin()];
+				if (it->used)
+				{
+					if (it->number > 0)
+					{
+						// fixed-length array
+						it->WriteFixedLength(buf);
+						I32 = 1;
+					} else if (it->number < 0)
+					{
+						// variable-length array
+						I32 = it->WriteVariableLength(nTotalSamp, buf);
+					} else
+						throw ErrSeqArray("Invalid FORMAT Number.");
+					buf.Len.push_back(I32);
+				} else {
+					buf.Len.push_back(0);
+				}
+			}
+		}
+
+		PackTime += VCF_Now() - t0;
+	}
+
+	/// parse a line, and append the values to 'Out'
+	virtual void ParseLine(char *line, int line_no, C_Int32 variant_index,
+		TVCF_Slice &Out)
+	{
+		const int nTotalSamp = Opt.nTotalSamp;
+		const char *pCh;
+
+		Cells.Reset(line);
+		cell = TVCF_Span();
+
+		// -----------------------------------------------------
+		// column 1: CHROM
+		Cells.GetCell(cell, false);
+		ChrPrefix(cell);
+		_PushString(Out.Chr, cell);
+
+
+		// -----------------------------------------------------
+		// column 2: POS
+		Cells.GetCell(cell, false);
+		Out.Pos.push_back(getInt32(cell.Ptr, Opt.RaiseError));
+
+
+		// -----------------------------------------------------
+		// column 3: ID
+		Cells.GetCell(cell, false);
+		if (cell.IsMissing()) cell.End = cell.Ptr;
+		_PushString(Out.RSID, cell);
+
+
+		// -----------------------------------------------------
+		// column 4 & 5: REF + ALT 
+		Cells.GetCell(cell, false);
+		_PushString(Out.Allele, cell);
+		string &allele = Out.Allele.back();
+		Cells.GetCell(cell, false);
+		if (!cell.Empty() && !cell.IsMissing())
+		{
+			allele.push_back(',');
+			allele.append(cell.Ptr, cell.End);
+		}
+		// determine how many alleles
+		const int num_allele = NumAllele(allele);
+
+
+		// -----------------------------------------------------
+		// column 6: QUAL
+		Cells.GetCell(cell, false);
+		Out.Qual.push_back(getFloat(cell.Ptr, Opt.RaiseError));
+
+
+		// -----------------------------------------------------
+		// column 7: FILTER
+		Cells.GetCell(cell, false);
+		if (cell.IsMissing()) cell.End = cell.Ptr;
+		_PushString(Out.Filter, cell);
+
+
+		// -----------------------------------------------------
+		// column 8: INFO
+
+		// initialize
+		vector<TVCF_Field_Info>::iterator pInfo;
+		for (pInfo = info_list.begin(); pInfo != info_list.end(); pInfo++)
+			pInfo->used = false;
+		Cells.GetCell(cell, false);
+
+		// parse
+		pCh = cell.Ptr;
+		while (*pCh)
+		{
+			pCh = _GetNameValue(pCh, name, value);
+			int k = info_index.Find(name);
+			pInfo = (k >= 0) ? (info_list.begin() + k) : info_list.end();
+
+			if (pInfo != info_list.end())
+			{
+				if (pInfo->used)
+				{
+					char buf[512];
+					snprintf(buf, sizeof(buf),
+						"LINE: %d, ignore duplicated INFO ID (%s).",
+						line_no, SHORT_TEXT(name.Str().c_str(), 256).c_str());
+					Out.Warning.push_back(buf);
+					continue;
+				}
+
+				if (pInfo->import_flag)
+				{
+					TVCF_Field_Buffer &buf = Out.Info[pInfo - info_list.begin()];
+					switch (pInfo->type)
+					{
+					case FIELD_TYPE_INT:
+						getInt32Array(value.Ptr, value.End, I32s, Opt.RaiseError);
+						pInfo->Check(I32s, num_allele, buf);
+						break;
+
+					case FIELD_TYPE_FLOAT:
+						getFloatArray(value.Ptr, value.End, F64s, Opt.RaiseError);
+						pInfo->Check(F64s, num_allele, buf);
+						break;
+
+					case FIELD_TYPE_FLAG:
+						if (!value.Empty())
+						{
+							throw ErrSeqArray("INFO ID '%s' should be a flag without values.",
+								name.Str().c_str());
+						}
+						buf.I32.push_back(1);
+						break;
+
+					case FIELD_TYPE_STRING:
+						getStringArray(value.Ptr, value.End, StrList);
+						pInfo->Check(StrList, num_allele, buf);
+						break;
+
+					default:
+						throw ErrSeqArray("Invalid INFO Type.");
+					}
+				}
+
+				pInfo->used = true;
+			} else {
+				Out.InfoMissing.insert(name.Str());
+			}
+		}
+
+		// for which does not exist
+		FillInfo(Out);
+
+
+		// -----------------------------------------------------
+		// column 9: FORMAT
+
+		Cells.GetCell(cell, false);
+
+		// the same layout as the previous line, 'fmt_ptr' and 'used' are kept
+		if (!fmt_cache_valid || !cell.Equal(fmt_cache))
+		{
+			// initialize
+			fmt_cache_valid = false;
+			vector< TVCF_Field_Format* >::iterator pFormat;
+			for (pFormat = fmt_ptr.begin(); pFormat != fmt_ptr.end(); pFormat++)
+				(*pFormat)->used = false;
+
+			// parse
+			bool first_id_flag = true;
+			fmt_ptr.clear();
+			pCh = cell.Ptr;
+			while (*pCh)
+			{
+				name.Ptr = pCh;
+				while ((*pCh != 0) && (*pCh != ':')) pCh ++;
+				name.End = pCh;
+				if (*pCh == ':') pCh ++;
+				_Trim_(name);
+
+				if (first_id_flag)
+				{
+					// genotype ID
+					if (!name.Equal(Opt.geno_id))
+					{
+						throw ErrSeqArray("The first FORMAT ID should be '%s'.",
+							Opt.geno_id.c_str());
+					}
+					first_id_flag = false;
+
+				} else {
+					// find ID
+					int k = format_index.Find(name);
+					if (k < 0)
+					{
+						Out.FormatMissing.insert(name.Str());
+					} else {
+						// push
+						format_list[k].used = true;
+						fmt_ptr.push_back(&format_list[k]);
+					}
+				}
+			}
+
+			fmt_cache.assign(cell.Ptr, cell.End);
+			fmt_cache_valid = true;
+		}
+
+
+		// -----------------------------------------------------
+		// columns for samples
+
+		// for-loop
+		for (int samp_idx=0; samp_idx < nTotalSamp; samp_idx ++)
+		{
+			const char *p;
+
+			// read
+			Cells.GetCell(cell, samp_idx >= (nTotalSamp-1));
+
+			// -------------------------------------------------
+			// the first field -- genotypes
+			value.Ptr = p = cell.Ptr;
+			while ((*p != 0) && (*p != ':')) p ++;
+			value.End = p;
+			pCh = (*p == ':') ? (p + 1) : p;
+
+			I32s.clear();
+			CVCFArena<C_Int16>::TSlot pAllele = Geno[samp_idx];
+			pAllele.clear();
+
+			p = value.Ptr;
+			while ((p < value.End) && VCF_IS_SPACE(*p)) p ++;
+			while (p < value.End)
+			{
+				C_Int64 val = 0;
+				const char *endptr = _StrToInt(p, val);
+
+				if (endptr == p)
+				{
+					if ((*p != '.') && Opt.RaiseError)
+					{
+						throw ErrSeqArray(
+							"Invalid integer conversion \"%s\".",
+							SHORT_TEXT(p).c_str());
+					}
+					val = -1;
+				} else {
+					if (val < 0)
+					{
+						val = -1;
+						if (Opt.RaiseError)
+						{
+							throw ErrSeqArray(
+								"Genotype code should be non-negative \"%s\".",
+								SHORT_TEXT(p).c_str());
+						}
+					} else if (val >= num_allele)
+					{
+						val = -1;
+						if (Opt.RaiseError)
+						{
+							throw ErrSeqArray(
+								"Genotype code is out of range \"%s\".",
+								SHORT_TEXT(p).c_str());
+						}
+					}
+					p = endptr;
+				}
+
+				pAllele.push_back(val);
+				while ((p < value.End) && (*p != '|') && (*p != '/'))
+					p ++;
+				if (p >= value.End)
+					break;
+				else if (*p == '|')
+				{
+					I32s.push_back(1); p ++;
+				} else if (*p == '/')
+				{
+					I32s.push_back(0); p ++;
+				}
+			}
+
+			SetSampleGeno(samp_idx, variant_index, Out);
+
+			// -------------------------------------------------
+			// the other field -- format id
+			for (size_t i=0; i < fmt_ptr.size(); i++)
+			{
+				TVCF_Field_Format *pFmt = fmt_ptr[i];
+				p = pCh;
+				while ((*p != 0) && (*p != ':')) p ++;
+
+				if ((pFmt!=NULL) && pFmt->import_flag)
+				{
+					// parse the field context [pCh, p)
+					switch (pFmt->type)
+					{
+					case FIELD_TYPE_INT:
+						{
+							CVCFArena<C_Int32>::TSlot I32 = pFmt->I32ss[samp_idx];
+							getInt32Array(pCh, p, I32, Opt.RaiseError);
+							pFmt->Check(I32, num_allele, NA_INTEGER);
+						}
+						break;
+
+					case FIELD_TYPE_FLOAT:
+						{
+							CVCFArena<C_Float64>::TSlot F64 = pFmt->F64ss[samp_idx];
+							getFloatArray(pCh, p, F64, Opt.RaiseError);
+							pFmt->Check(F64, num_allele, R_NaN);
+						}
+						break;
+
+					case FIELD_TYPE_STRING:
+						{
+							CVCFArena<string>::TSlot UTF8 = pFmt->UTF8ss[samp_idx];
+							getStringArray(pCh, p, UTF8);
+							pFmt->Check(UTF8, num_allele, BlackString);
+						}
+						break;
+
+					default:
+						throw ErrSeqArray("Invalid FORMAT Type.");
+					}
+				}
+
+				pCh = (*p == ':') ? (p + 1) : p;
+			}
+		}
+
+		// -------------------------------------------------
+		// write genotypes and FORMAT fields
+		WriteGenoFormat(num_allele, variant_index, Out);
+	}
+};
+
+
+/// a class of parsing BCF2 records into columns, used by one thread
+class CBCFParser: public CVCFParser
+{
+public:
+	CBCFParser(const TVCF_Option &opt, const vector<TVCF_Field_Info> &info,
+		const vector<TVCF_Field_Format> &fmt, const TBCF_Header &header):
+		CVCFParser(opt, info, fmt), Header(header)
+	{
+		IsText = false;
+		// map the dictionary to INFO and FORMAT fields
+		const size_t n = Header.Dict.size();
+		dict_info.resize(n); dict_format.resize(n); dict_geno.resize(n);
+		for (size_t i=0; i < n; i++)
+		{
+			TVCF_Span s;
+			s.Ptr = Header.Dict[i].c_str();
+			s.End = s.Ptr + Header.Dict[i].size();
+			dict_info[i] = info_index.Find(s);
+			dict_format[i] = format_index.Find(s);
+			dict_geno[i] = (Header.Dict[i] == Opt.geno_id);
+		}
+	}
+
+protected:
+	const TBCF_Header &Header;
+	vector<int> dict_info;     //< the index in 'info_list' or -1
+	vector<int> dict_format;   //< the index in 'format_list' or -1
+	vector<C_Int8> dict_geno;  //< whether it is the genotype ID
+	TBCF_Cursor R;
+
+	/// get the dictionary index of a key
+	COREARRAY_INLINE C_Int32 DictKey()
+	{
+		C_Int32 k = R.TypedInt();
+		if ((k < 0) || (k >= (C_Int32)Header.Dict.size()))
+			throw ErrSeqArray("Invalid BCF dictionary index (%d).", k);
+		return k;
+	}
+
+	/// parse a record, and append the values to 'Out'
+	virtual void ParseLine(char *line, int line_no, C_Int32 variant_index,
+		TVCF_Slice &Out)
+	{
+		const int nTotalSamp = Opt.nTotalSamp;
+		const C_UInt8 *rec = (const C_UInt8*)line;
+		const C_UInt32 l_shared = _BCF_U32(rec);
+		const C_UInt32 l_indiv = _BCF_U32(rec + 4);
+		int type, num;
+
+		// -----------------------------------------------------
+		// the shared part
+		R.Ptr = rec + 8;
+		R.End = R.Ptr + l_shared;
+		R.Need(24);
+
+		// CHROM
+		const string &chr = TBCF_Header::Name(Header.Contig,
+			(C_Int32)_BCF_U32(R.Ptr));
+		cell.Ptr = chr.c_str();
+		cell.End = cell.Ptr + chr.size();
+		ChrPrefix(cell);
+		_PushString(Out.Chr, cell);
+		cell = TVCF_Span();
+
+		// POS, 0-based
+		Out.Pos.push_back((C_Int32)_BCF_U32(R.Ptr + 4) + 1);
+
+		// QUAL
+		double qual = 0;
+		_BCF_Float(R.Ptr + 12, BCF_BT_FLOAT, qual);
+		Out.Qual.push_back(qual);
+
+		const int n_allele = _BCF_U32(R.Ptr + 16) >> 16;
+		const int n_info = _BCF_U32(R.Ptr + 16) & 0xFFFF;
+		const int n_fmt = _BCF_U32(R.Ptr + 20) >> 24;
+		const int n_sample = _BCF_U32(R.Ptr + 20) & 0xFFFFFF;
+		if (n_sample != nTotalSamp)
+		{
+			throw ErrSeqArray("The number of samples (%d) should be %d.",
+				n_sample, nTotalSamp);
+		}
+		R.Ptr += 24;
+
+		// ID
+		R.TypedStr(value);
+		if (value.IsMissing()) value.End = value.Ptr;
+		_PushString(Out.RSID, value);
+
+		// REF + ALT
+		Out.Allele.push_back(BlackString);
+		string &allele = Out.Allele.back();
+		for (int i=0; i < n_allele; i++)
+		{
+			R.TypedStr(value);
+			if ((i == 1) && (n_allele == 2) && (value.Empty() || value.IsMissing()))
+				continue;
+			if (i > 0) allele.push_back(',');
+			allele.append(value.Ptr, value.End);
+		}
+		const int num_allele = NumAllele(allele);
+
+		// FILTER
+		R.Desc(type, num);
+		Out.Filter.push_back(BlackString);
+		if (num > 0)
+		{
+			R.Ints(type, num, I32s);
+			string &filter = Out.Filter.back();
+			for (size_t i=0; i < I32s.size(); i++)
+			{
+				if (i > 0) filter.push_back(';');
+				filter.append(TBCF_Header::Name(Header.Dict, I32s[i]));
+			}
+		}
+
+		// INFO
+		vector<TVCF_Field_Info>::iterator pInfo;
+		for (pInfo = info_list.begin(); pInfo != info_list.end(); pInfo++)
+			pInfo->used = false;
+
+		for (int i=0; i < n_info; i++)
+		{
+			C_Int32 key = DictKey();
+			R.Desc(type, num);
+			int k = dict_info[key];
+			if (k < 0)
+			{
+				Out.InfoMissing.insert(Header.Dict[key]);
+				R.Skip(type, num);
+				continue;
+			}
+
+			pInfo = info_list.begin() + k;
+			if (pInfo->used)
+			{
+				char buf[512];
+				snprintf(buf, sizeof(buf),
+					"LINE: %d, ignore duplicated INFO ID (%s).",
+					line_no, SHORT_TEXT(Header.Dict[key].c_str(), 256).c_str());
+				Out.Warning.push_back(buf);
+				R.Skip(type, num);
+				continue;
+			}
+
+			if (pInfo->import_flag)
+			{
+				TVCF_Field_Buffer &buf = Out.Info[k];
+				switch (pInfo->type)
+				{
+				case FIELD_TYPE_INT:
+					if (type == BCF_BT_CHAR)
+					{
+						R.Str(num, value);
+						getInt32Array(value.Ptr, value.End, I32s, Opt.RaiseError);
+					} else
+						R.Ints(type, num, I32s);
+					pInfo->Check(I32s, num_allele, buf);
+					break;
+
+				case FIELD_TYPE_FLOAT:
+					if (type == BCF_BT_CHAR)
+					{
+						R.Str(num, value);
+						getFloatArray(value.Ptr, value.End, F64s, Opt.RaiseError);
+					} else
+						R.Floats(type, num, F64s);
+					pInfo->Check(F64s, num_allele, buf);
+					break;
+
+				case FIELD_TYPE_FLAG:
+					R.Skip(type, num);
+					buf.I32.push_back(1);
+					break;
+
+				case FIELD_TYPE_STRING:
+					if (type != BCF_BT_CHAR)
+					{
+						throw ErrSeqArray("INFO ID '%s' should be a string.",
+							Header.Dict[key].c_str());
+					}
+					R.Str(num, value);
+					getStringArray(value.Ptr, value.End, StrList);
+					pInfo->Check(StrList, num_allele, buf);
+					break;
+
+				default:
+					throw ErrSeqArray("Invalid INFO Type.");
+				}
+			} else
+				R.Skip(type, num);
+
+			pInfo->used = true;
+		}
+
+		// for which does not exist
+		FillInfo(Out);
+
+
+		// -----------------------------------------------------
+		// the individual part: FORMAT
+
+		R.Ptr = R.End;
+		R.End = R.Ptr + l_indiv;
+
+		vector<TVCF_Field_Format>::iterator pFmt;
+		for (pFmt = format_list.begin(); pFmt != format_list.end(); pFmt++)
+			pFmt->used = false;
+
+		bool has_geno = false;
+		for (int i=0; i < n_fmt; i++)
+		{
+			C_Int32 key = DictKey();
+			R.Desc(type, num);
+
+			if (i == 0)
+			{
+				// genotype ID
+				if (!dict_geno[key])
+				{
+					throw ErrSeqArray("The first FORMAT ID should be '%s'.",
+						Opt.geno_id.c_str());
+				}
+				ParseGeno(type, num, num_allele, variant_index, Out);
+				has_geno = true;
+				continue;
+			}
+
+			int k = dict_format[key];
+			if (k < 0)
+			{
+				Out.FormatMissing.insert(Header.Dict[key]);
+				R.Skip(type, num * nTotalSamp);
+				continue;
+			}
+			pFmt = format_list.begin() + k;
+			if (pFmt->used || !pFmt->import_flag)
+			{
+				R.Skip(type, num * nTotalSamp);
+				continue;
+			}
+
+			// parse the values of all samples
+			switch (pFmt->type)
+			{
+			case FIELD_TYPE_INT:
+				for (int j=0; j < nTotalSamp; j++)
+				{
+					CVCFArena<C_Int32>::TSlot I32 = pFmt->I32ss[j];
+					if (type == BCF_BT_CHAR)
+					{
+						R.Str(num, value);
+						getInt32Array(value.Ptr, value.End, I32, Opt.RaiseError);
+					} else
+						R.Ints(type, num, I32);
+					pFmt->Check(I32, num_allele, NA_INTEGER);
+				}
+				break;
+
+			case FIELD_TYPE_FLOAT:
+				for (int j=0; j < nTotalSamp; j++)
+				{
+					CVCFArena<C_Float64>::TSlot F64 = pFmt->F64ss[j];
+					if (type == BCF_BT_CHAR)
+					{
+						R.Str(num, value);
+						getFloatArray(value.Ptr, value.End, F64, Opt.RaiseError);
+					} else
+						R.Floats(type, num, F64);
+					pFmt->Check(F64, num_allele, R_NaN);
+				}
+				break;
+
+			case FIELD_TYPE_STRING:
+				if (type != BCF_BT_CHAR)
+				{
+					throw ErrSeqArray("FORMAT ID '%s' should be a string.",
+						Header.Dict[key].c_str());
+				}
+				for (int j=0; j < nTotalSamp; j++)
+				{
+					CVCFArena<string>::TSlot UTF8 = pFmt->UTF8ss[j];
+					R.Str(num, value);
+					getStringArray(value.Ptr, value.End, UTF8);
+					pFmt->Check(UTF8, num_allele, BlackString);
+				}
+				break;
+
+			default:
+				throw ErrSeqArray("Invalid FORMAT Type.");
+			}
+			pFmt->used = true;
+		}
+
+		// missing genotypes if no FORMAT
+		if (!has_geno)
+		{
+			for (int j=0; j < nTotalSamp; j++)
+			{
+				I32s.clear();
+				Geno[j].clear();
+				SetSampleGeno(j, variant_index, Out);
+			}
+		}
+
+		// -------------------------------------------------
+		// write genotypes and FORMAT fields
+		WriteGenoFormat(num_allele, variant_index, Out);
+	}
+
+	/// parse the genotypes of all samples, (allele+1)*2 + phased
+	void ParseGeno(int type, int num, int num_allele, C_Int32 variant_index,
+		TVCF_Slice &Out)
+	{
+		if ((type < BCF_BT_INT8) || (type > BCF_BT_INT32))
+			throw ErrSeqArray("Invalid BCF genotype type (%d).", type);
+		const int sz = BCF_TYPE_SIZE[type];
+		R.Need((size_t)sz * num * Opt.nTotalSamp);
+
+		for (int samp_idx=0; samp_idx < Opt.nTotalSamp; samp_idx++)
+		{
+			I32s.clear();
+			CVCFArena<C_Int16>::TSlot pAllele = Geno[samp_idx];
+			pAllele.clear();
+
+			for (int j=0; j < num; j++)
+			{
+				C_Int32 v;
+				if (!_BCF_Int(R.Ptr + j*sz, type, v)) break;
+				C_Int32 val = (v == NA_INTEGER) ? -1 : ((v >> 1) - 1);
+				if (val >= num_allele)
+				{
+					if (Opt.RaiseError)
+					{
+						throw ErrSeqArray(
+							"Genotype code is out of range \"%d\".", val);
+					}
+					val = -1;
+				} else if (val < -1)
+				{
+					if (Opt.RaiseError)
+					{
+						throw ErrSeqArray(
+							"Genotype code should be non-negative \"%d\".", val);
+					}
+					val = -1;
+				}
+				pAllele.push_back(val);
+				if (j > 0) I32s.push_back((v != NA_INTEGER) ? (v & 1) : 0);
+			}
+			R.Ptr += (size_t)sz * num;
+
+			SetSampleGeno(samp_idx, variant_index, Out);
+		}
+	}
+};
+
+
+
+// ===========================================================
+// the writer of parsed values
+// ===========================================================
+
+/// a class of appending the parsed values to the GDS nodes
+class CVCFWriter
+{
+public:
+	PdAbstractArray varIdx, varChr, varPos, varRSID, varAllele;
+	PdAbstractArray varQual, varFilter;
+	PdAbstractArray varGeno, varGenoLen, varGenoExtraIdx, varGenoExtra;
+	PdAbstractArray varPhase, varPhaseExtraIdx, varPhaseExtra;
+
+	vector<TVCF_Field_Info> *info_list;
+	vector<TVCF_Field_Format> *format_list;
+	vector<string> filter_list;
+	double Time;  //< the seconds of appending to GDS
+
+	CVCFWriter()
+	{
+		Stage.Start = Stage.Count = 0;
+		StageVarId = 0;
+		Time = 0;
+	}
+
+	/// stage the values in a slice, and append to GDS if the stage is full
+	void Write(const TVCF_Batch &Batch, const TVCF_Slice &S)
+	{
+		if (S.Count <= 0) return;
+		if (Stage.Count <= 0)
+		{
+			StageVarId = Batch.VariantBase + S.Start + 1;
+			if (IsFull(S))
+			{
+				// large enough, no need to copy
+				Append(S, StageVarId);
+				return;
+			}
+			Stage.Clear(info_list->size(), format_list->size());
+		}
+		Stage.Append(S);
+		if (IsFull(Stage)) Flush();
+	}
+
+	/// append all slices in a batch before 'nSlice'
+	void Write(const TVCF_Batch &Batch, size_t nSlice)
+	{
+		for (size_t i=0; i < nSlice; i++)
+			Write(Batch, Batch.Slices[i]);
+	}
+
+	/// append the staged values to GDS
+	void Flush()
+	{
+		if (Stage.Count > 0)
+		{
+			Append(Stage, StageVarId);
+			Stage.Clear(info_list->size(), format_list->size());
+		}
+	}
+
+protected:
+	TVCF_Slice Stage;     //< the staged values
+	C_Int32 StageVarId;   //< the first variant id in the stage
+	vector<C_Int32> I32s; //< the buffer of variant id and filter
+
+	inline static bool IsFull(const TVCF_Slice &S)
+	{
+		return (S.Count >= VCF_FLUSH_VARIANT) || (S.Geno.size() >= VCF_FLUSH_BYTE);
+	}
+
+	/// append the values in a slice with a column per call
+	void Append(const TVCF_Slice &S, C_Int32 var_id)
+	{
+		const double t0 = VCF_Now();
+
+		// variant id
+		I32s.resize(S.Count);
+		for (int i=0; i < S.Count; i++)
+			I32s[i] = var_id + i;
+		Append(varIdx, I32s);
+
+		AppendString(varChr, S.Chr);
+		Append(varPos, S.Pos);
+		AppendString(varRSID, S.RSID);
+		AppendString(varAllele, S.Allele);
+		Append(varQual, S.Qual);
+
+		// filter
+		I32s.clear();
+		for (vector<string>::const_iterator it = S.Filter.begin();
+			it != S.Filter.end(); it++)
+		{
+			C_Int32 I32;
+			if (!it->empty())
+			{
+				vector<string>::iterator p =
+					std::find(filter_list.begin(), filter_list.end(), *it);
+				if (p == filter_list.end())
+				{
+					filter_list.push_back(*it);
+					I32 = filter_list.size();
+				} else
+					I32 = p - filter_list.begin() + 1;
+			} else
+				I32 = NA_INTEGER;
+			I32s.push_back(I32);
+		}
+		Append(varFilter, I32s);
+
+		// INFO
+		for (size_t i=0; i < info_list->size(); i++)
+		{
+			TVCF_Field_Info &F = (*info_list)[i];
+			if (F.import_flag)
+			{
+				const TVCF_Field_Buffer &B = S.Info[i];
+				if (F.type == FIELD_TYPE_FLOAT)
+					Append(F.data_obj, B.F64);
+				else if (F.type == FIELD_TYPE_STRING)
+					AppendString(F.data_obj, B.UTF8);
+				else
+					Append(F.data_obj, B.I32);
+				Append(F.len_obj, B.Len);
+			}
+		}
+
+		// genotypes
+		if (!S.Geno.empty())
+		{
+			GDS_Array_AppendData(varGeno, S.Geno.size(), &S.Geno[0], svInt8);
+		}
+		Append(varGenoLen, S.GenoLen);
+		Append(varGenoExtra, S.GenoExtra);
+		Append(varGenoExtraIdx, S.GenoExtraIdx);
+		if (varPhase)
+		{
+			Append(varPhase, S.Phase);
+			Append(varPhaseExtra, S.PhaseExtra);
+			Append(varPhaseExtraIdx, S.PhaseExtraIdx);
+		}
+
+		// FORMAT
+		for (size_t i=0; i < format_list->size(); i++)
+		{
+			TVCF_Field_Format &F = (*format_list)[i];
+			if (F.import_flag)
+			{
+				const TVCF_Field_Buffer &B = S.Format[i];
+				if (F.type == FIELD_TYPE_FLOAT)
+					Append(F.data_obj, B.F64);
+				else if (F.type == FIELD_TYPE_STRING)
+					AppendString(F.data_obj, B.UTF8);
+				else
+					Append(F.data_obj, B.I32);
+				Append(F.len_obj, B.Len);
+			}
+		}
+
+		Time += VCF_Now() - t0;
+	}
+
+	inline static void Append(PdAbstractArray obj, const vector<C_Int32> &v)
+	{
+		if (obj && !v.empty())
+			GDS_Array_AppendData(obj, v.size(), &v[0], svInt32);
+	}
+	inline static void Append(PdAbstractArray obj, const vector<double> &v)
+	{
+		if (obj && !v.empty())
+			GDS_Array_AppendData(obj, v.size(), &v[0], svFloat64);
+	}
+	inline static void AppendString(PdAbstractArray obj, const vector<string> &v)
+	{
+		if (obj && !v.empty())
+			GDS_Array_AppendData(obj, v.size(), &v[0], svStrUTF8);
+	}
+};
+
+
+
+// ===========================================================
+// the pipeline of parsing and writing
+// ===========================================================
+
+/// the shared state of threads: thread 0 writes the previous batch, and
+///   the other threads parse the slices of the current batch
+struct TVCF_Pipeline
+{
+	TVCF_Batch *ParseBatch;      //< the batch to be parsed
+	TVCF_Batch *WriteBatch;      //< the batch to be written, or NULL
+	vector<CVCFParser*> Parser;  //< the parsers
+	CVCFWriter *Writer;          //< the writer
+	string WriteErr;             //< the error message in writing
+};
+
+static void VCF_Pipeline_Thread(PdThread Thread, int ThreadIndex, void *Param)
+{
+	TVCF_Pipeline &P = *((TVCF_Pipeline*)Param);
+	if (ThreadIndex == 0)
+	{
+		if (P.WriteBatch)
+		{
+			try {
+				P.Writer->Write(*P.WriteBatch, P.WriteBatch->Slices.size());
+			} catch (ErrCoreArray &E) {
+				P.WriteErr = E.what();
+			} catch (std::exception &E) {
+				P.WriteErr = E.what();
+			} catch (...) {
+				P.WriteErr = "unknown error in writing.";
+			}
+		}
+	} else if (ThreadIndex <= (int)P.ParseBatch->Slices.size())
+	{
+		P.Parser[ThreadIndex-1]->Parse(*P.ParseBatch,
+			P.ParseBatch->Slices[ThreadIndex-1]);
+	}
+}
+
+
+
+/// show the number of lines read and the throughput
+static void VCF_Progress(double nLine, double nByte, double sec)
+{
+	if (sec <= 0) sec = 1e-9;
+	Rprintf("\t%.0f lines, %.0f lines/s, %.1f MB/s, %.0fs\n",
+		nLine, nLine / sec, nByte / sec / (1024.0*1024), sec);
+}
+
+
+extern "C"
+{
+// ===========================================================
+// Convert from VCF4: VCF4 -> GDS
+// ===========================================================
+
+/// VCF4 or BCF2 --> GDS
+COREARRAY_DLL_EXPORT SEXP SEQ_Parse_VCF4(SEXP vcf_fn, SEXP header,
+	SEXP gds_root, SEXP param, SEXP ReadLineFun, SEXP ReadLine_Param,
+	SEXP ReadLine_N, SEXP ChrPrefix, SEXP rho)
+{
+	const char *fn = CHAR(STRING_ELT(vcf_fn, 0));
+
+	// define a variable for reading lines
+	CReadLine RL;
+	// or reading BCF2 records
+	CBCFReader BR;
+	TBCF_Header BH;
+	bool IsBCF = false;
+	// or reading the lines in regions with the index
+	CVCFRegionReader RR;
+	bool IsRegion = false;
+
+	// the position of error
+	int err_line = 0, err_column = 0;
+	string err_cell;
+
+	// parsers
+	vector<CVCFParser*> Parsers;
+
+	COREARRAY_TRY
+
+		// the number of calling PROTECT
+		int nProtected = 0;
+
+
+		// =========================================================
+		// initialize variables		
+
+		TVCF_Option Opt;
+		// the total number of samples
+		Opt.nTotalSamp = Rf_asInteger(GetListElement(param, "sample.num"));
+		// the variable name for genotypic data
+		Opt.geno_id = CHAR(STRING_ELT(GetListElement(param, "genotype.var.name"), 0));
+		// raise an error
+		Opt.RaiseError = (Rf_asLogical(GetListElement(param, "raise.error")) == TRUE);
+		// verbose
+		const bool Verbose =
+			(Rf_asLogical(GetListElement(param, "verbose")) == TRUE);
+		// the number of threads
+		int nThread = Rf_asInteger(GetListElement(param, "num.thread"));
+		if ((nThread == NA_INTEGER) || (nThread < 1)) nThread = 1;
+
+		// the number of ploidy
+		Opt.num_ploidy = Rf_asInteger(GetListElement(header, "num.ploidy"));
+		if (Opt.num_ploidy <= 0)
+			throw ErrSeqArray("Invalid header$num.ploidy: %d.", Opt.num_ploidy);
+
+		// GDS nodes
 		PdAbstractArray Root = GDS_R_SEXP2Obj(gds_root, FALSE);
+		CVCFWriter W;
+
+		// filter level list
+		{
+			SEXP level = GetListElement(param, "filter.levels");
+			if (!isNull(level))
+			{
+				for (int i=0; i < (int)XLENGTH(level); i++)
+					W.filter_list.push_back(CHAR(STRING_ELT(level, i)));
+			}
+		}
 
-		PdAbstractArray varIdx = GDS_Node_Path(Root, "variant.id", TRUE);
-		PdAbstractArray varChr = GDS_Node_Path(Root, "chromosome", TRUE);
-		PdAbstractArray varPos = GDS_Node_Path(Root, "position", TRUE);
-		PdAbstractArray varRSID = GDS_Node_Path(Root, "annotation/id", TRUE);
-		PdAbstractArray varAllele = GDS_Node_Path(Root, "allele", TRUE);
+		W.varIdx = GDS_Node_Path(Root, "variant.id", TRUE);
+		W.varChr = GDS_Node_Path(Root, "chromosome", TRUE);
+		W.varPos = GDS_Node_Path(Root, "position", TRUE);
+		W.varRSID = GDS_Node_Path(Root, "annotation/id", TRUE);
+		W.varAllele = GDS_Node_Path(Root, "allele", TRUE);
 
-		PdAbstractArray varQual = GDS_Node_Path(Root, "annotation/qual", TRUE);
-		PdAbstractArray varFilter = GDS_Node_Path(Root, "annotation/filter", TRUE);
+		W.varQual = GDS_Node_Path(Root, "annotation/qual", TRUE);
+		W.varFilter = GDS_Node_Path(Root, "annotation/filter", TRUE);
 
-		PdAbstractArray varGeno = GDS_Node_Path(Root, "genotype/data", TRUE);
-		PdAbstractArray varGenoLen = GDS_Node_Path(Root, "genotype/@data", TRUE);
-		PdAbstractArray varGenoExtraIdx = GDS_Node_Path(Root, "genotype/extra.index", TRUE);
-		PdAbstractArray varGenoExtra = GDS_Node_Path(Root, "genotype/extra", TRUE);
+		W.varGeno = GDS_Node_Path(Root, "genotype/data", TRUE);
+		W.varGenoLen = GDS_Node_Path(Root, "genotype/@data", TRUE);
+		W.varGenoExtraIdx = GDS_Node_Path(Root, "genotype/extra.index", TRUE);
+		W.varGenoExtra = GDS_Node_Path(Root, "genotype/extra", TRUE);
 
-		const int GenoNumBits= GDS_Array_GetBitOf(varGeno);
-		if ((GenoNumBits!=2) && (GenoNumBits!=8))
+		Opt.GenoNumBits = GDS_Array_GetBitOf(W.varGeno);
+		if ((Opt.GenoNumBits!=2) && (Opt.GenoNumBits!=8))
 			throw ErrSeqArray("Invalid data type in genotype/data.");
-		const int GenoBitMask = ~((-1) << GenoNumBits);
+		Opt.GenoBitMask = ~(~0u << Opt.GenoNumBits);
 
-		PdAbstractArray varPhase, varPhaseExtraIdx, varPhaseExtra;
-		if (num_ploidy > 1)
+		if (Opt.num_ploidy > 1)
 		{
-			varPhase = GDS_Node_Path(Root, "phase/data", TRUE);
-			varPhaseExtraIdx = GDS_Node_Path(Root, "phase/extra.index", TRUE);
-			varPhaseExtra = GDS_Node_Path(Root, "phase/extra", TRUE);
+			W.varPhase = GDS_Node_Path(Root, "phase/data", TRUE);
+			W.varPhaseExtraIdx = GDS_Node_Path(Root, "phase/extra.index", TRUE);
+			W.varPhaseExtra = GDS_Node_Path(Root, "phase/extra", TRUE);
 		} else {
-			varPhase = varPhaseExtraIdx = varPhaseExtra = NULL;
+			W.varPhase = W.varPhaseExtraIdx = W.varPhaseExtra = NULL;
 		}
+		Opt.HasPhase = (W.varPhase != NULL);
 
 		// GetListElement: info
 		vector<TVCF_Field_Info> info_list;
@@ -822,76 +3620,76 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Parse_VCF4(SEXP vcf_fn, SEXP header,
 				val.len_obj = GDS_Node_Path(Root,
 					(string("annotation/format/") + val.name + "/@data").c_str(), FALSE);
 				format_list.push_back(val);
-
-				switch (val.type)
-				{
-					case FIELD_TYPE_INT:
-						format_list.back().I32ss.resize(nTotalSamp);
-						break;
-					case FIELD_TYPE_FLOAT:
-						format_list.back().F64ss.resize(nTotalSamp);
-						break;
-					case FIELD_TYPE_STRING:
-						format_list.back().UTF8ss.resize(nTotalSamp);
-						break;
-					default:
-						throw ErrSeqArray("Invalid FORMAT Type.");
-				}
+				format_list.back().Init(Opt.nTotalSamp);
 			}
 		}
 
-		// variant id (integer)
-		C_Int32 variant_index = GDS_Array_GetTotalCount(varIdx);
-
-		// the string buffer
-		string name, value;
-		name.reserve(256);
-		value.reserve(4096);
-
-		// the numeric buffer
-		C_Int32 I32;
-		vector<C_Int32> I32s;
-		I32s.reserve(nTotalSamp);
-
-		C_Float64 F64;
-		vector<C_Float64> F64s;
-		F64s.reserve(nTotalSamp);
+		W.info_list = &info_list;
+		W.format_list = &format_list;
 
-		// the string buffer
-		vector<string> StrList;
-		StrList.reserve(nTotalSamp);
-
-		// genotypes
-		vector< vector<C_Int16> > Geno;
-		Geno.resize(nTotalSamp);
-		vector<C_Int8> I8s;
-		I8s.reserve(nTotalSamp * num_ploidy);
-
-		const char *pCh;
-		vector<TVCF_Field_Info>::iterator pInfo;
-		vector< TVCF_Field_Format* >::iterator pFormat;
-		vector< TVCF_Field_Format* > fmt_ptr;
-		fmt_ptr.reserve(format_list.size());
+		// variant id (integer)
+		C_Int32 variant_index = GDS_Array_GetTotalCount(W.varIdx);
 
 		// chr prefix
-		vector<string> ChrPref;
 		for (R_xlen_t i=0; i < XLENGTH(ChrPrefix); i++)
-			ChrPref.push_back(CHAR(STRING_ELT(ChrPrefix, i)));
+			Opt.ChrPref.push_back(CHAR(STRING_ELT(ChrPrefix, i)));
 
 		// =========================================================
 		// initialize calling
-		SEXP R_Read_Call;
-		PROTECT(R_Read_Call =
-			LCONS(ReadLineFun, LCONS(ReadLine_Param,
-			LCONS(ReadLine_N, R_NilValue))));
-		nProtected ++;
-		RL.Init(R_Read_Call, rho);
+		SEXP Region = GetListElement(param, "region");
+		if (isNull(ReadLineFun))
+		{
+			if (!isNull(Region))
+			{
+				if (CBCFReader::IsBCF(fn))
+					throw ErrSeqArray("Import by regions requires a bgzipped VCF file.");
+				// read the lines in the regions directly
+				SEXP chr = GetListElement(Region, "chr");
+				SEXP st = GetListElement(Region, "start");
+				SEXP ed = GetListElement(Region, "end");
+				vector<string> Chr(XLENGTH(chr));
+				vector<C_Int64> Start(Chr.size()), End(Chr.size());
+				for (size_t i=0; i < Chr.size(); i++)
+				{
+					Chr[i] = CHAR(STRING_ELT(chr, i));
+					Start[i] = (C_Int64)REAL(st)[i];
+					End[i] = (C_Int64)REAL(ed)[i];
+				}
+				RR.Init(fn, Chr, Start, End);
+				IsRegion = true;
+			} else if (CBCFReader::IsBCF(fn))
+			{
+				// read BCF2 records directly
+				BR.Open(fn, BH);
+				IsBCF = true;
+			} else {
+				// read the file directly
+				RL.InitFile(fn);
+			}
+		} else {
+			SEXP R_Read_Call;
+			PROTECT(R_Read_Call =
+				LCONS(ReadLineFun, LCONS(ReadLine_Param,
+				LCONS(ReadLine_N, R_NilValue))));
+			nProtected ++;
+			RL.Init(R_Read_Call, rho);
+		}
+
+
+		// parsers
+		for (int i=0; i < nThread; i++)
+		{
+			if (IsBCF)
+				Parsers.push_back(new CBCFParser(Opt, info_list, format_list, BH));
+			else
+				Parsers.push_back(new CVCFParser(Opt, info_list, format_list));
+		}
 
 
 		// =========================================================
 		// skip the header
 
-		while (!RL.IfEnd())
+		while (!IsBCF && !IsRegion && !RL.IfEnd())
 		{
 			const char *p = RL.ReadLine();
 			if (strncmp(p, "#CHROM", 6) == 0)
@@ -899,502 +3697,280 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Parse_VCF4(SEXP vcf_fn, SEXP header,
 		}
 
 
-		// the number of alleles in total at a specified site
-		int num_allele;
-
 		// =========================================================
 		// parse the context
 
-		while (!RL.IfEnd())
-		{
-			// =====================================================
-			// scan line by line
-
-			// -----------------------------------------------------
-			// variant id
-			variant_index ++;
-			GDS_Array_AppendData(varIdx, 1, &variant_index, svInt32);
+		TVCF_Batch Batch[2];
+		TVCF_Pipeline P;
+		P.Parser = Parsers;
+		P.Writer = &W;
+		P.WriteBatch = NULL;
+		int cur = 0;
 
+		// the timing counters
+		const double StartTime = VCF_Now();
+		double ReadTime = 0, LastReport = StartTime;
+		double NumByte = 0;
+		double NumLine = 0;
 
-			// -----------------------------------------------------
-			// column 1: CHROM
-			RL.GetCell(cell, false);
+		while (true)
+		{
+			// read lines
+			TVCF_Batch &B = Batch[cur];
+			const double t0 = VCF_Now();
+			if (IsBCF)
 			{
-				const char *s = cell.c_str();
-				vector<string>::iterator it = ChrPref.begin();
-				for (; it != ChrPref.end(); it++)
-				{
-					if (StrCaseCmp(it->c_str(), s))
-					{
-						cell.erase(0, it->size());
-						break;
-					}
-				}
-			}
-			GDS_Array_AppendString(varChr, cell.c_str());
-
-
-			// -----------------------------------------------------
-			// column 2: POS
-			RL.GetCell(cell, false);
-			I32 = getInt32(cell, RaiseError);
-			GDS_Array_AppendData(varPos, 1, &I32, svInt32);
-
-
-			// -----------------------------------------------------
-			// column 3: ID
-			RL.GetCell(cell, false);
-			if (cell == ".") cell.clear();
-			GDS_Array_AppendString(varRSID, cell.c_str());
-
-
-			// -----------------------------------------------------
-			// column 4 & 5: REF + ALT 
-			RL.GetCell(value, false);
-			RL.GetCell(cell, false);
-			if (!cell.empty() && (cell != "."))
+				B.Read(BR, VCF_BATCH_LINE*nThread, VCF_BATCH_BYTE*nThread,
+					variant_index);
+			} else if (IsRegion)
 			{
-				value.push_back(',');
-				value.append(cell);
+				B.Read(RR, VCF_BATCH_LINE*nThread, VCF_BATCH_BYTE*nThread,
+					variant_index);
+			} else {
+				B.Read(RL, VCF_BATCH_LINE*nThread, VCF_BATCH_BYTE*nThread,
+					variant_index);
 			}
-			GDS_Array_AppendString(varAllele, value.c_str());
-			// determine how many alleles
-			num_allele = 0;
-			pCh = value.c_str();
-			while (*pCh != 0)
-			{
-				num_allele ++;
-				while ((*pCh != 0) && (*pCh != ',')) pCh ++;
-				if (*pCh == ',') pCh ++;
-			}
-
-
-			// -----------------------------------------------------
-			// column 6: QUAL
-			RL.GetCell(cell, false);
-			F64 = getFloat(cell, RaiseError);
-			GDS_Array_AppendData(varQual, 1, &F64, svFloat64);
-
+			B.Split(B.NumLine() > 0 ? nThread : 0, info_list.size(),
+				format_list.size());
+			ReadTime += VCF_Now() - t0;
+			NumLine += B.NumLine();
+			NumByte += B.Text.size();
+			if ((B.NumLine() <= 0) && !P.WriteBatch)
+				break;
 
-			// -----------------------------------------------------
-			// column 7: FILTER
-			RL.GetCell(cell, false);
-			if (!cell.empty() && (cell != "."))
+			// parse the current batch and write the previous batch
+			P.ParseBatch = &B;
+			if (nThread > 1)
 			{
-				vector<string>::iterator p =
-					std::find(filter_list.begin(), filter_list.end(), cell);
-				if (p == filter_list.end())
-				{
-					filter_list.push_back(cell);
-					I32 = filter_list.size();
-				} else
-					I32 = p - filter_list.begin() + 1;
-			} else
-				I32 = NA_INTEGER;
-			GDS_Array_AppendData(varFilter, 1, &I32, svInt32);
-
-
-			// -----------------------------------------------------
-			// column 8: INFO
-
-			// initialize
-			for (pInfo = info_list.begin(); pInfo != info_list.end(); pInfo++)
-				pInfo->used = false;
-			RL.GetCell(cell, false);
+				GDS_Parallel_RunThreads(VCF_Pipeline_Thread, &P, nThread + 1);
+			} else {
+				// not multithreaded
+				for (int i=0; i <= nThread; i++)
+					VCF_Pipeline_Thread(NULL, i, &P);
+			}
+			if (!P.WriteErr.empty())
+				throw ErrSeqArray(P.WriteErr);
 
-			// parse
-			pCh = cell.c_str();
-			while (*pCh)
+			// warnings of the written batch
+			if (P.WriteBatch)
 			{
-				pCh = _GetNameValue(pCh, name, value);
-				for (pInfo=info_list.begin(); pInfo != info_list.end(); pInfo++)
+				vector<TVCF_Slice> &SS = P.WriteBatch->Slices;
+				for (size_t i=0; i < SS.size(); i++)
 				{
-					if (pInfo->name == name)
-						break;
-				}
-
-				if (pInfo != info_list.end())
-				{
-					if (pInfo->used)
+					TVCF_Slice &S = SS[i];
+					for (size_t j=0; j < S.Warning.size(); j++)
+						Rf_warning("%s", S.Warning[j].c_str());
+					set<string>::iterator it;
+					for (it=S.InfoMissing.begin(); it != S.InfoMissing.end(); it++)
 					{
-						Rf_warning("LINE: %d, ignore duplicated INFO ID (%s).",
-							RL.LineNo(), name.c_str());
-						continue;
-					}
-
-					if (pInfo->import_flag)
-					{
-						switch (pInfo->type)
+						if (info_missing.find(*it) == info_missing.end())
 						{
-						case FIELD_TYPE_INT:
-							getInt32Array(value, I32s, RaiseError);
-							pInfo->Check(I32s, name, num_allele);
-							GDS_Array_AppendData(pInfo->data_obj, I32s.size(),
-								&(I32s[0]), svInt32);
-							break;
-
-						case FIELD_TYPE_FLOAT:
-							getFloatArray(value, F64s, RaiseError);
-							pInfo->Check(F64s, name, num_allele);
-							GDS_Array_AppendData(pInfo->data_obj, F64s.size(),
-								&(F64s[0]), svFloat64);
-							break;
-
-						case FIELD_TYPE_FLAG:
-							if (!value.empty())
-							{
-								throw ErrSeqArray("INFO ID '%s' should be a flag without values.",
-									name.c_str());
-							}
-							I32 = 1;
-							GDS_Array_AppendData(pInfo->data_obj, 1,
-								&I32, svInt32);
-							break;
-
-						case FIELD_TYPE_STRING:
-							getStringArray(value, StrList);
-							pInfo->Check(StrList, name, num_allele);
-							for (int k=0; k < (int)StrList.size(); k++)
-							{
-								GDS_Array_AppendString(pInfo->data_obj,
-									StrList[k].c_str());
-							}
-							break;
-
-						default:
-							throw ErrSeqArray("Invalid INFO Type.");
+							info_missing.insert(*it);
+							warning("Unknown INFO ID '%s' is ignored.", it->c_str());
 						}
 					}
-
-					pInfo->used = true;
-				} else {
-					set<string>::iterator it = info_missing.find(name);
-					if (it == info_missing.end())
+					for (it=S.FormatMissing.begin(); it != S.FormatMissing.end(); it++)
 					{
-						info_missing.insert(name);
-						warning("Unknown INFO ID '%s' is ignored.", name.c_str());
+						if (format_missing.find(*it) == format_missing.end())
+						{
+							format_missing.insert(*it);
+							warning("Unknown FORMAT ID '%s' is ignored.",
+								it->c_str());
+						}
 					}
 				}
 			}
 
-			// for which does not exist
-			for (pInfo = info_list.begin(); pInfo != info_list.end(); pInfo++)
+			// check errors in parsing
+			for (size_t i=0; i < B.Slices.size(); i++)
 			{
-				if (!pInfo->used && pInfo->import_flag)
+				TVCF_Slice &S = B.Slices[i];
+				if (S.HasError)
 				{
-					switch (pInfo->type)
-					{
-					case FIELD_TYPE_INT:
-						pInfo->Fill(I32s, NA_INTEGER);
-						break;
-					case FIELD_TYPE_FLOAT:
-						pInfo->Fill(F64s, R_NaN);
-						break;
-					case FIELD_TYPE_FLAG:
-						I32 = 0;
-						GDS_Array_AppendData(pInfo->data_obj, 1, &I32, svInt32);
-						break;
-					case FIELD_TYPE_STRING:
-						pInfo->Fill(StrList, string());
-						break;
-					default:
-						throw ErrSeqArray("Invalid INFO Type.");
-					}
-					pInfo->used = true;
+					// write the lines before the error
+					W.Write(B, i);
+					W.Flush();
+					err_line = S.ErrLine;
+					err_column = S.ErrColumn;
+					err_cell = S.ErrCell;
+					throw ErrSeqArray(S.ErrMsg);
 				}
 			}
 
+			if (B.NumLine() <= 0) break;
+			P.WriteBatch = &B;
+			cur = 1 - cur;
 
-			// -----------------------------------------------------
-			// column 9: FORMAT
-
-			// initialize
-			for (pFormat = fmt_ptr.begin(); pFormat != fmt_ptr.end(); pFormat++)
-				(*pFormat)->used = false;
-			RL.GetCell(cell, false);
-
-			// parse
-			bool first_id_flag = true;
-			fmt_ptr.clear();
-			pCh = cell.c_str();
-			while (*pCh)
+			// show progress
+			if (Verbose && (VCF_Now() - LastReport >= VCF_PROGRESS_SECOND))
 			{
-				name.clear();
-				while ((*pCh != 0) && (*pCh != ':'))
-					{ name.push_back(*pCh); pCh ++; }
-				if (*pCh == ':') pCh ++;
-				_Trim_(name);
-
-				if (first_id_flag)
-				{
-					// genotype ID
-					if (name != geno_id)
-					{
-						throw ErrSeqArray("The first FORMAT ID should be '%s'.",
-							geno_id.c_str());
-					}
-					first_id_flag = false;
-
-				} else {
-					// find ID
-					vector<TVCF_Field_Format>::iterator it;
-					for (it = format_list.begin(); it != format_list.end(); it++)
-					{
-						if (it->name == name)
-							{ it->used = true; break; }
-					}
-					if (it == format_list.end())
-					{
-						set<string>::iterator it = format_missing.find(name);
-						if (it == format_missing.end())
-						{
-							format_missing.insert(name);
-							warning("Unknown FORMAT ID '%s' is ignored.",
-								name.c_str());
-						}
-					} else {
-						// push
-						fmt_ptr.push_back(&(*it));
-					}
-				}
+				LastReport = VCF_Now();
+				VCF_Progress(NumLine, NumByte, LastReport - StartTime);
 			}
+		}
+		W.Flush();
 
+		// the seconds of stages, summed over parsing threads
+		const double Elapsed = VCF_Now() - StartTime;
+		double TokTime=0, ParseTime=0, PackTime=0;
+		for (size_t i=0; i < Parsers.size(); i++)
+		{
+			TokTime += Parsers[i]->TokenizeTime();
+			ParseTime += Parsers[i]->ParseTime();
+			PackTime += Parsers[i]->PackingTime();
+		}
+		if (Verbose)
+		{
+			VCF_Progress(NumLine, NumByte, Elapsed);
+			Rprintf("\tseconds: read %.2f, tokenize ~%.2f, parse ~%.2f, "
+				"pack %.2f, append %.2f\n", ReadTime, TokTime, ParseTime,
+				PackTime, W.Time);
+		}
 
-			// -----------------------------------------------------
-			// columns for samples
+		// set returned value: list(filter=levels(filter), stats)
+		PROTECT(rv_ans = NEW_LIST(2));
+		nProtected ++;
+		SEXP Levels = NEW_CHARACTER(W.filter_list.size());
+		SET_ELEMENT(rv_ans, 0, Levels);
+		for (int i=0; i < (int)W.filter_list.size(); i++)
+			SET_STRING_ELT(Levels, i, mkChar(W.filter_list[i].c_str()));
+
+		static const char *StatName[] = { "lines", "bytes", "seconds",
+			"read", "tokenize.est", "parse.est", "pack", "append" };
+		const double StatVal[] = { NumLine, NumByte, Elapsed,
+			ReadTime, TokTime, ParseTime, PackTime, W.Time };
+		const int nStat = sizeof(StatVal) / sizeof(double);
+		SEXP Stat = NEW_NUMERIC(nStat);
+		SET_ELEMENT(rv_ans, 1, Stat);
+		SEXP nm = PROTECT(NEW_CHARACTER(nStat));
+		nProtected ++;
+		for (int i=0; i < nStat; i++)
+		{
+			REAL(Stat)[i] = StatVal[i];
+			SET_STRING_ELT(nm, i, mkChar(StatName[i]));
+		}
+		SET_NAMES(Stat, nm);
+		nm = PROTECT(NEW_CHARACTER(2));
+		nProtected ++;
+		SET_STRING_ELT(nm, 0, mkChar("filter"));
+		SET_STRING_ELT(nm, 1, mkChar("stats"));
+		SET_NAMES(rv_ans, nm);
 
-			// for-loop
-			for (int samp_idx=0; samp_idx < nTotalSamp; samp_idx ++)
-			{
-				const char *p;
+		UNPROTECT(nProtected);
 
-				// read
-				RL.GetCell(cell, samp_idx >= (nTotalSamp-1));
+	CORE_CATCH({
+		char buf[4096];
+		// records are counted in BCF2 files and regions, instead of lines
+		const char *unit = (IsBCF || IsRegion) ? "RECORD" : "LINE";
+		if (err_line <= 0)
+			err_line = IsBCF ? BR.RecNo() : (IsRegion ? RR.LineNo() : RL.LineNo());
+		if (err_column > 0)
+		{
+			snprintf(buf, sizeof(buf),
+				"%s\nFILE: %s\n%s: %d, COLUMN: %d, %s\n",
+				GDS_GetError(), fn, unit, err_line, err_column, err_cell.c_str());
+		} else {
+			snprintf(buf, sizeof(buf), "%s\nFILE: %s\n%s: %d\n",
+				GDS_GetError(), fn, unit, err_line);
+		}
+		GDS_SetError(buf);
+		has_error = true;
+	});
 
-				// -------------------------------------------------
-				// the first field -- genotypes
-				pCh = p = cell.c_str();
-				while ((*p != 0) && (*p != ':')) p ++;
-				value.assign(pCh, p);
-				pCh = (*p == ':') ? (p + 1) : p;
+	for (size_t i=0; i < Parsers.size(); i++)
+		delete Parsers[i];
+	if (has_error) error(GDS_GetError());
 
-				I32s.clear();
-				vector<C_Int16> &pAllele = Geno[samp_idx];
-				pAllele.clear();
+	// output
+	return(rv_ans);
+}
 
-				p = SKIP(value.c_str());
-				while (*p)
-				{
-					char *endptr = (char*)p;
-					C_Int32 val = strtol(p, &endptr, 10);
 
-					if (endptr == p)
-					{
-						if ((*p != '.') && RaiseError)
-						{
-							throw ErrSeqArray(
-								"Invalid integer conversion \"%s\".",
-								SHORT_TEXT(p).c_str());
-						}
-						val = -1;
-					} else {
-						if (val < 0)
-						{
-							val = -1;
-							if (RaiseError)
-							{
-								throw ErrSeqArray(
-									"Genotype code should be non-negative \"%s\".",
-									SHORT_TEXT(p).c_str());
-							}
-						} else if (val >= num_allele)
-						{
-							val = -1;
-							if (RaiseError)
-							{
-								throw ErrSeqArray(
-									"Genotype code is out of range \"%s\".",
-									SHORT_TEXT(p).c_str());
-							}
-						}
-						p = endptr;
-					}
+/// get the header of a BCF2 file in VCF text
+/** \param bcf_fn  the file name
+ *  \return the lines of header, followed by a line with the first FORMAT
+ *          field of each sample in the first record (like "./."), which
+ *          determines the ploidy in seqVCF.Header()
+**/
+COREARRAY_DLL_EXPORT SEXP SEQ_BCF_Header(SEXP bcf_fn)
+{
+	const char *fn = CHAR(STRING_ELT(bcf_fn, 0));
 
-					pAllele.push_back(val);
-					while ((*p != 0) && (*p != '|') && (*p != '/'))
-						p ++;
-					if (*p == '|')
-					{
-						I32s.push_back(1); p ++;
-					} else if (*p == '/')
-					{
-						I32s.push_back(0); p ++;
-					}
-				}
+	COREARRAY_TRY
 
-				// check pAllele
-				if ((int)pAllele.size() < num_ploidy)
-					pAllele.resize(num_ploidy, -1);
+		CBCFReader BR;
+		TBCF_Header BH;
+		BR.Open(fn, BH);
+		vector<string> lines = BH.Lines;
 
-				if (varPhase)
-				{
-					// write phasing information
-					if ((int)I32s.size() < (num_ploidy-1))
-						I32s.resize(num_ploidy-1, 0);
-					GDS_Array_AppendData(varPhase, num_ploidy-1, &(I32s[0]), svInt32);
-					if ((int)I32s.size() > (num_ploidy-1))
-					{
-						// E.g., triploid call: 0/0/1
-						int Len = num_ploidy - (int)I32s.size() - 1;
-						GDS_Array_AppendData(varPhaseExtra, Len, &(I32s[num_ploidy-1]), svInt32);
-						I32 = samp_idx + 1;
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-						I32 = variant_index;
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-						I32 = Len;
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-					}
-				}
+		vector<char> rec;
+		if (BR.ReadRecord(rec))
+		{
+			const C_UInt8 *p = (const C_UInt8*)&rec[0];
+			TBCF_Cursor R;
+			R.Ptr = p + 8 + _BCF_U32(p);
+			R.End = R.Ptr + _BCF_U32(p + 4);
+			const int n_fmt = _BCF_U32(p + 8 + 20) >> 24;
+			const int n_sample = _BCF_U32(p + 8 + 20) & 0xFFFFFF;
+
+			string s = ".\t.\t.\t.\t.\t.\t.\t.\t";
+			int type=BCF_BT_NULL, num=0;
+			if (n_fmt > 0)
+			{
+				s.append(TBCF_Header::Name(BH.Dict, R.TypedInt()));
+				R.Desc(type, num);
+			} else
+				s.push_back('.');
 
-				// -------------------------------------------------
-				// the other field -- format id
-				for (size_t i=0; i < fmt_ptr.size(); i++)
+			// "." for each value of the first FORMAT field
+			vector<C_Int32> I32s;
+			for (int i=0; i < n_sample; i++)
+			{
+				s.push_back('\t');
+				if ((type >= BCF_BT_INT8) && (type <= BCF_BT_INT32))
+					R.Ints(type, num, I32s);
+				else
+					I32s.clear();
+				for (size_t j=0; j < I32s.size(); j++)
 				{
-					TVCF_Field_Format *pFmt = fmt_ptr[i];
-					p = pCh;
-					while ((*p != 0) && (*p != ':')) p ++;
-
-					if ((pFmt!=NULL) && pFmt->import_flag)
-					{
-						// get the field context
-						value.assign(pCh, p);
-
-						// parse the field
-						switch (pFmt->type)
-						{
-						case FIELD_TYPE_INT:
-							getInt32Array(value, pFmt->I32ss[samp_idx], RaiseError);
-							pFmt->Check(pFmt->I32ss[samp_idx], name, num_allele, NA_INTEGER);
-							break;
-
-						case FIELD_TYPE_FLOAT:
-							getFloatArray(value, pFmt->F64ss[samp_idx], RaiseError);
-							pFmt->Check(pFmt->F64ss[samp_idx], name, num_allele, R_NaN);
-							break;
-
-						case FIELD_TYPE_STRING:
-							getStringArray(value, pFmt->UTF8ss[samp_idx]);
-							pFmt->Check(pFmt->UTF8ss[samp_idx], name, num_allele, BlackString);
-							break;
-
-						default:
-							throw ErrSeqArray("Invalid FORMAT Type.");
-						}
-					}
-
-					pCh = (*p == ':') ? (p + 1) : p;
+					if (j > 0) s.push_back('/');
+					s.push_back('.');
 				}
+				if (I32s.empty()) s.push_back('.');
 			}
+			lines.push_back(s);
+		}
 
-			// -------------------------------------------------
-			// write genotypes
+		PROTECT(rv_ans = NEW_CHARACTER(lines.size()));
+		for (size_t i=0; i < lines.size(); i++)
+			SET_STRING_ELT(rv_ans, i, mkChar(lines[i].c_str()));
+		UNPROTECT(1);
 
-			// determine how many bits (GenoNumBits == 2, 4 or 8)
-			int num_bits = GenoNumBits;
-			// plus ONE for missing value
-			while ((num_allele + 1) > (1 << num_bits))
-				num_bits += GenoNumBits;
-			I32 = num_bits / GenoNumBits;
-			GDS_Array_AppendData(varGenoLen, 1, &I32, svInt32);
+	COREARRAY_CATCH
+}
 
-			// write to the variable "genotype"
-			for (int bits=0; bits < num_bits; bits += GenoNumBits)
-			{
-				I8s.clear();
-				for (int i=0; i < nTotalSamp; i++)
-				{
-					vector<C_Int16> &pAllele = Geno[i];
-					for (int j=0; j < num_ploidy; j++)
-						I8s.push_back((pAllele[j] >> bits) & GenoBitMask);
-				}
-				GDS_Array_AppendData(varGeno, nTotalSamp*num_ploidy,
-					&(I8s[0]), svInt8);
-			}
 
-			// write to "genotype/extra"
-			for (int i=0; i < nTotalSamp; i++)
-			{
-				vector<C_Int16> &pGeno = Geno[i];
-				if ((int)pGeno.size() > num_ploidy)
-				{
-					// E.g., triploid call: 0/0/1
-					int Len = num_ploidy - (int)pGeno.size() - 1;
-					GDS_Array_AppendData(varGenoExtra, Len, &(pGeno[num_ploidy-1]), svInt32);
-					I32 = i + 1;
-					GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-					I32 = variant_index;
-					GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-					I32 = Len;
-					GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-				}
-			}
 
+/// get the sequence names in the tabix or CSI index of a bgzipped VCF file
+/** \param vcf_fn  the file name, with 'vcf_fn.tbi' or 'vcf_fn.csi'
+ *  \return the sequence names in the order of the file
+**/
+COREARRAY_DLL_EXPORT SEXP SEQ_VCF_IndexSeqNames(SEXP vcf_fn)
+{
+	const char *fn = CHAR(STRING_ELT(vcf_fn, 0));
 
-			// -------------------------------------------------
-			// for-loop all format IDs: write
-			for (vector<TVCF_Field_Format>::iterator it = format_list.begin();
-				it != format_list.end(); it++)
-			{
-				if (it->import_flag)
-				{
-					if (it->used)
-					{
-						if (it->number > 0)
-						{
-							// fixed-length array
-							it->WriteFixedLength();
-							I32 = 1;
-						} else if (it->number < 0)
-						{
-							// variable-length array
-							I32 = it->WriteVariableLength(nTotalSamp, I32s, F64s);
-						} else
-							throw ErrSeqArray("Invalid FORMAT Number.");
-						GDS_Array_AppendData(it->len_obj, 1, &I32, svInt32);
-					} else {
-						I32 = 0;
-						GDS_Array_AppendData(it->len_obj, 1, &I32, svInt32);
-					}
-				}
-			}
-		}
+	COREARRAY_TRY
 
-		// set returned value: levels(filter)
-		PROTECT(rv_ans = NEW_CHARACTER(filter_list.size()));
-		for (int i=0; i < (int)filter_list.size(); i++)
-			SET_STRING_ELT(rv_ans, i, mkChar(filter_list[i].c_str()));
-		nProtected ++;
+		CVCFIndex Index;
+		Index.Load(fn);
+		PROTECT(rv_ans = NEW_CHARACTER(Index.Names.size()));
+		for (size_t i=0; i < Index.Names.size(); i++)
+			SET_STRING_ELT(rv_ans, i, mkChar(Index.Names[i].c_str()));
+		UNPROTECT(1);
 
-		UNPROTECT(nProtected);
+	COREARRAY_CATCH
+}
 
-	CORE_CATCH({
-		char buf[4096];
-		if (RL.ColumnNo() > 0)
-		{
-			snprintf(buf, sizeof(buf),
-				"%s\nFILE: %s\nLINE: %d, COLUMN: %d, %s\n",
-				GDS_GetError(), fn, RL.LineNo(), RL.ColumnNo(), cell.c_str());
-		} else {
-			snprintf(buf, sizeof(buf), "%s\nFILE: %s\nLINE: %d\n",
-				GDS_GetError(), fn, RL.LineNo());
-		}
-		GDS_SetError(buf);
-		has_error = true;
-	});
-	if (has_error) error(GDS_GetError());
 
-	// output
-	return(rv_ans);
-}
 
 } // extern "C"
@@ -43,7 +43,7 @@ static SEXP VAR_LOGICAL(PdGDSObj Node, SEXP Array)
 	return Array;
 }
 
-static void MAP_INDEX(PdAbstractArray Node, const vector<C_BOOL> &sel,
+static void MAP_INDEX(PdAbstractArray Node, const CSelection &sel,
 	vector<int> &out_len, vector<C_BOOL> &out_var_sel,
 	C_Int32 &out_var_start, C_Int32 &out_var_count)
 {
@@ -73,9 +73,7 @@ static void MAP_INDEX(PdAbstractArray Node, const vector<C_BOOL> &sel,
 			throw ErrSeqArray("Invalid dimension.");
 
 		// find the start
-		int _start = 0;
-		for (; _start < (int)sel.size(); _start++)
-			if (sel[_start]) break;
+		int _start = sel.next(0);
 		// find the end
 		int _end = sel.size()-1;
 		for (; _end >= 0; _end --)
@@ -134,14 +132,24 @@ static void MAP_INDEX(PdAbstractArray Node, const vector<C_BOOL> &sel,
 
 
 /// Get data from a working space
-COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
+COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name,
+	SEXP use_packed, SEXP use_raw)
 {
+	int packed_flag = Rf_asLogical(use_packed);
+	if (packed_flag == NA_LOGICAL)
+		error("'.packed' must be TRUE or FALSE.");
+	int raw_flag = Rf_asLogical(use_raw);
+	if (raw_flag == NA_LOGICAL)
+		error("'.useraw' must be TRUE or FALSE.");
+
 	COREARRAY_TRY
 
 		SEXP tmp;
 
 		// the selection
 		TInitObject::TSelection &Sel = Init.Selection(gdsfile);
+		// C_BOOL arrays of the selection, released after the call
+		vector<C_BOOL> VarBuf, SampBuf;
 		// the GDS root node
 		PdGDSObj Root = GDS_R_SEXP2Obj(GetListElement(gdsfile, "root"), TRUE);
 
@@ -168,7 +176,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				GDS_Array_GetDim(N, DLen, 1);
 				if ((int)Sel.Sample.size() != DLen[0])
 					throw ErrSeqArray("Invalid dimension of 'sample.id'.");
-				SelPtr[0] = &Sel.Sample[0];
+				SelPtr[0] = Sel.Sample.view(SampBuf);
 				rv_ans = GDS_R_Array_Read(N, NULL, NULL, &SelPtr[0], 0);
 			}
 
@@ -192,7 +200,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				GDS_Array_GetDim(N, DLen, 1);
 				if ((int)Sel.Variant.size() != DLen[0])
 					throw ErrSeqArray("Invalid dimension of '%s'.", s);
-				SelPtr[0] = &Sel.Variant[0];
+				SelPtr[0] = Sel.Variant.view(VarBuf);
 				rv_ans = GDS_R_Array_Read(N, NULL, NULL, &SelPtr[0], 0);
 			}
 
@@ -221,8 +229,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 
 				CVarApply Var;
 
-				SelPtr[0] = &Sel.Variant[0];
-				SelPtr[1] = &Sel.Sample[0];
+				SelPtr[0] = Sel.Variant.view(VarBuf);
+				SelPtr[1] = Sel.Sample.view(SampBuf);
 				if (DimCnt == 3)
 					SelPtr[2] = Var.NeedTRUE(DLen[2]);
 
@@ -231,10 +239,14 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				rv_ans = GDS_R_Array_Read(N, NULL, NULL, NULL, 0);
 			}
 
-		} else if (strcmp(s, "genotype") == 0)
+		} else if ((strcmp(s, "genotype") == 0) ||
+			(strcmp(s, "$dosage") == 0) || (strcmp(s, "$dosage_alt") == 0))
 		{
 			// ===========================================================
-			// genotypic data
+			// genotypic data, or dosages of reference/alternate alleles
+
+			const bool IsGeno = (strcmp(s, "genotype") == 0);
+			const bool Alt = (strcmp(s, "$dosage_alt") == 0);
 
 			// init selection
 			if (Sel.Sample.empty())
@@ -253,45 +265,91 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 			}
 
 			// the number of selected variants
-			int nVariant = 0;
-			for (vector<C_BOOL>::iterator it = Sel.Variant.begin();
-				it != Sel.Variant.end(); it ++)
-			{
-				if (*it) nVariant ++;
-			}
+			int nVariant = Sel.Variant.count();
 			if (nVariant > 0)
 			{
 				// initialize the GDS Node list
 				CVarApplyByVariant NodeVar;
 				NodeVar.InitObject(CVariable::ctGenotype,
-					"genotype/data", Root, Sel.Variant.size(),
-					&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0], false);
-
-				// the number of calling PROTECT
-				int SIZE = NodeVar.Num_Sample * NodeVar.DLen[2];
-				PROTECT(rv_ans = NEW_INTEGER(nVariant * SIZE));
-				PROTECT(tmp = NEW_INTEGER(3));
-					INTEGER(tmp)[0] = NodeVar.DLen[2];
-					INTEGER(tmp)[1] = NodeVar.Num_Sample;
-					INTEGER(tmp)[2] = nVariant;
-				SET_DIM(rv_ans, tmp);
-				SEXP name_list;
-				PROTECT(name_list = NEW_LIST(3));
-				PROTECT(tmp = NEW_CHARACTER(3));
-					SET_STRING_ELT(tmp, 0, mkChar("allele"));
-					SET_STRING_ELT(tmp, 1, mkChar("sample"));
-					SET_STRING_ELT(tmp, 2, mkChar("variant"));
-					SET_NAMES(name_list, tmp);
-				SET_DIMNAMES(rv_ans, name_list);
-
-				int *base = INTEGER(rv_ans);
+					"genotype/data", gdsfile, Sel.Variant, Sel.Sample, false);
+				NodeVar.SetBlockRead(VARIANT_BLOCK_SIZE);
+
+				// the output type, 2-bit packed dosages of reference allele
+				//   if 'genotype' and '.packed=TRUE'
+				CVarApplyByVariant::TGenoOut Type;
+				if (packed_flag)
+					Type = CVarApplyByVariant::goDosagePacked;
+				else if (IsGeno)
+					Type = raw_flag ? CVarApplyByVariant::goRaw :
+						CVarApplyByVariant::goInt32;
+				else
+					Type = raw_flag ? CVarApplyByVariant::goDosageRaw :
+						CVarApplyByVariant::goDosageInt32;
+				const bool IsInt = (Type == CVarApplyByVariant::goInt32) ||
+					(Type == CVarApplyByVariant::goDosageInt32);
+				// the number of bytes and values per variant
+				const size_t SIZE = NodeVar.GenoOutSize(Type);
+				const size_t nVal = IsInt ? SIZE / sizeof(int) : SIZE;
+
+				if (IsInt)
+					PROTECT(rv_ans = NEW_INTEGER(R_xlen_t(nVariant) * nVal));
+				else
+					PROTECT(rv_ans = NEW_RAW(R_xlen_t(nVariant) * nVal));
+				int nProtected = 1;
+
+				if ((Type == CVarApplyByVariant::goInt32) ||
+					(Type == CVarApplyByVariant::goRaw))
+				{
+					PROTECT(tmp = NEW_INTEGER(3));
+						INTEGER(tmp)[0] = NodeVar.DLen[2];
+						INTEGER(tmp)[1] = NodeVar.Num_Sample;
+						INTEGER(tmp)[2] = nVariant;
+					SET_DIM(rv_ans, tmp);
+					SEXP name_list;
+					PROTECT(name_list = NEW_LIST(3));
+					PROTECT(tmp = NEW_CHARACTER(3));
+						SET_STRING_ELT(tmp, 0, mkChar("allele"));
+						SET_STRING_ELT(tmp, 1, mkChar("sample"));
+						SET_STRING_ELT(tmp, 2, mkChar("variant"));
+						SET_NAMES(name_list, tmp);
+					SET_DIMNAMES(rv_ans, name_list);
+					nProtected += 3;
+				} else {
+					PROTECT(tmp = NEW_INTEGER(2));
+						INTEGER(tmp)[0] = nVal;
+						INTEGER(tmp)[1] = nVariant;
+					SET_DIM(rv_ans, tmp);
+					nProtected ++;
+					if (Type != CVarApplyByVariant::goDosagePacked)
+					{
+						SEXP name_list;
+						PROTECT(name_list = NEW_LIST(2));
+						PROTECT(tmp = NEW_CHARACTER(2));
+							SET_STRING_ELT(tmp, 0, mkChar("sample"));
+							SET_STRING_ELT(tmp, 1, mkChar("variant"));
+							SET_NAMES(name_list, tmp);
+						SET_DIMNAMES(rv_ans, name_list);
+						nProtected += 2;
+					}
+				}
+
+				C_UInt8 *base = IsInt ? (C_UInt8*)INTEGER(rv_ans) : RAW(rv_ans);
+				bool RawWarn = false;
+				vector<C_UInt8> BufU8;
+				vector<int> BufI32;
 				do {
-					NodeVar.ReadGenoData(base);
+					int nPlane;
+					const C_UInt8 *g = NodeVar.ReadGenoRaw(nPlane);
+					if (!NodeVar.UnpackGeno(base, Type, Alt, g, nPlane,
+							BufU8, BufI32))
+						RawWarn = true;
 					base += SIZE;
 				} while (NodeVar.NextCell());
+				if (RawWarn)
+					warning("RAW type may not be sufficient to store genotypes.");
 
 				// finally
-				UNPROTECT(4);
+				UNPROTECT(nProtected);
 			}
 
 		} else if (strcmp(s, "@genotype") == 0)
@@ -304,7 +362,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 			{
 				rv_ans = GDS_R_Array_Read(N, &st, &cnt, NULL, 0);
 			} else {
-				C_BOOL *SelList = &Sel.Variant[0];
+				C_BOOL *SelList = Sel.Variant.view(VarBuf);
 				rv_ans = GDS_R_Array_Read(N, &st, &cnt, &SelList, 0);
 			}
 		} else if (strncmp(s, "annotation/info/@", 17) == 0)
@@ -318,7 +376,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				{
 					rv_ans = GDS_R_Array_Read(N, &st, &cnt, NULL, 0);
 				} else {
-					C_BOOL *SelList = &Sel.Variant[0];
+					C_BOOL *SelList = Sel.Variant.view(VarBuf);
 					rv_ans = GDS_R_Array_Read(N, &st, &cnt, &SelList, 0);
 				}
 			}
@@ -339,7 +397,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				{
 					GDS_Array_GetDim(N, DLen, 2);
 					CVarApply Var;
-					SelPtr[0] = &Sel.Variant[0];
+					SelPtr[0] = Sel.Variant.view(VarBuf);
 					if (DimCnt == 2)
 						SelPtr[1] = Var.NeedTRUE(DLen[1]);
 					rv_ans = GDS_R_Array_Read(N, NULL, NULL, &SelPtr[0], 0);
@@ -406,7 +464,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 				{
 					rv_ans = GDS_R_Array_Read(N, &st, &cnt, NULL, 0);
 				} else {
-					C_BOOL *SelList = &Sel.Variant[0];
+					C_BOOL *SelList = Sel.Variant.view(VarBuf);
 					rv_ans = GDS_R_Array_Read(N, &st, &cnt, &SelList, 0);
 				}
 			}
@@ -435,7 +493,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 
 			CVarApply Var;
 			SelPtr[0] = &var_sel[0];
-			SelPtr[1] = &Sel.Sample[0];
+			SelPtr[1] = Sel.Sample.view(SampBuf);
 			if (DimCnt == 3)
 				SelPtr[2] = Var.NeedTRUE(DLen[2]);
 
@@ -484,7 +542,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 			CVarApply Var;
 			if (Sel.Sample.empty())
 				Sel.Sample.resize(nSamp, TRUE);
-			SelPtr[0] = &Sel.Sample[0];
+			SelPtr[0] = Sel.Sample.view(SampBuf);
 			if (DimCnt == 2)
 				SelPtr[1] = Var.NeedTRUE(DLen[1]);
 
@@ -495,6 +553,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name)
 			throw ErrSeqArray(
 				"'%s' is not a standard variable name, and the standard format:\n"
 				"\tsample.id, variant.id, position, chromosome, allele, genotype\n"
+				"\t$dosage, $dosage_alt\n"
 				"\tannotation/id, annotation/qual, annotation/filter\n"
 				"\tannotation/info/VARIABLE_NAME, annotation/format/VARIABLE_NAME\n"
 				"\tsample.annotation/VARIABLE_NAME", s);
@@ -0,0 +1,331 @@
+// ===========================================================
+//
+// IBD.cpp: Identity by descent with blocks of variants
+//
+// Copyright (C) 2015    Xiuwen Zheng
+//
+// This file is part of SeqArray.
+//
+// SeqArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// SeqArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SeqArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "ReadByVariant.h"
+
+
+// ===================================================================== //
+
+/// the number of 64-bit words of variants in a block
+#define IBD_BLOCK_WORD     8
+/// the number of variants in a block
+#define IBD_BLOCK_SIZE     (IBD_BLOCK_WORD * 64)
+/// the number of samples in a side of a tile
+#define IBD_TILE_SIZE      64
+/// the maximum number of bit planes of an allele
+#define IBD_MAX_PLANE      8
+
+
+/// Average IBD over loci with bit-sliced genotypes
+/** For a block of variants, each sample stores bit masks over variants:
+ *  the valid genotypes, the homozygotes and the bit planes of two alleles.
+ *  The matches of alleles between two samples are counted with popcount,
+ *  and the sample pairs are processed in tiles.
+**/
+class COREARRAY_DLL_LOCAL CIBDOneLocus
+{
+public:
+	CIBDOneLocus(int nSample): Num_Sample(nSample)
+	{
+		Stride = (2 + 2*IBD_MAX_PLANE) * IBD_BLOCK_WORD;
+		Bits.resize(size_t(nSample) * Stride);
+		Reset();
+	}
+
+	/// clear the block
+	void Reset()
+	{
+		memset(&Bits[0], 0, sizeof(C_UInt64)*Bits.size());
+		memset(Mb, 0, sizeof(Mb));
+		memset(MbTotal, 0, sizeof(MbTotal));
+		memset(FullMask, 0, sizeof(FullMask));
+		Num_Variant = 0;
+		Num_Plane = 1;
+	}
+
+	inline bool IsEmpty() const { return Num_Variant <= 0; }
+	inline bool IsFull() const { return Num_Variant >= IBD_BLOCK_SIZE; }
+
+	/// add a diploid variant with nSample*2 alleles, NA_RAW for missing
+	void AddVariant(const C_UInt8 *geno)
+	{
+		const int v = Num_Variant ++;
+		const int w = v >> 6;
+		const C_UInt64 b = C_UInt64(1) << (v & 0x3F);
+
+		// the allele counts
+		C_Int64 cnt[256];
+		memset(cnt, 0, sizeof(cnt));
+		C_Int64 nValid=0, SumS=0;
+		const C_UInt8 *g = geno;
+		for (int i=0; i < Num_Sample; i++, g+=2)
+		{
+			if ((g[0] != NA_RAW) && (g[1] != NA_RAW))
+			{
+				nValid ++;
+				cnt[g[0]] ++; cnt[g[1]] ++;
+				SumS += (g[0] == g[1]) ? 4 : 2;
+			}
+		}
+
+		// the average of M_{ij} over valid pairs:
+		//   sum_{i<j} 4*M_{ij} = (sum_k cnt_k^2 - sum_i 4*M_i') / 2
+		const C_Int64 nSum = nValid * (nValid - 1) / 2;
+		if (nSum <= 0) return;
+		C_Int64 Sq = 0;
+		int MaxAllele = 0;
+		for (int k=0; k < 255; k++)
+		{
+			if (cnt[k] > 0)
+			{
+				Sq += cnt[k] * cnt[k];
+				MaxAllele = k;
+			}
+		}
+		const double mb = (double)((Sq - SumS) / 2) / nSum * 0.25;
+		Mb[v] = mb;
+		MbTotal[w] += mb;
+		FullMask[w] |= b;
+
+		while ((MaxAllele >> Num_Plane) > 0) Num_Plane ++;
+
+		// the bit masks
+		g = geno;
+		for (int i=0; i < Num_Sample; i++, g+=2)
+		{
+			if ((g[0] != NA_RAW) && (g[1] != NA_RAW))
+			{
+				C_UInt64 *p = &Bits[size_t(i) * Stride];
+				p[w] |= b;
+				if (g[0] == g[1]) p[IBD_BLOCK_WORD + w] |= b;
+				p += 2*IBD_BLOCK_WORD;
+				for (int k=0; k < IBD_MAX_PLANE; k++, p+=2*IBD_BLOCK_WORD)
+				{
+					if ((g[0] >> k) & 0x01) p[w] |= b;
+					if ((g[1] >> k) & 0x01) p[IBD_BLOCK_WORD + w] |= b;
+				}
+			}
+		}
+	}
+
+	/// accumulate the block to the numerators and denominators
+	void Run(double *pN, double *pD, int nThread)
+	{
+		N = pN; D = pD;
+		const int nTile = (Num_Sample + IBD_TILE_SIZE - 1) / IBD_TILE_SIZE;
+		Tiles.clear();
+		for (int i=0; i < nTile; i++)
+			for (int j=i; j < nTile; j++)
+				Tiles.push_back(pair<int,int>(i, j));
+		Num_Thread = nThread;
+		if (nThread > 1)
+			GDS_Parallel_RunThreads(Thread, this, nThread);
+		else
+			DoTiles(0);
+		Reset();
+	}
+
+private:
+	int Num_Sample;    ///< the number of samples
+	int Num_Variant;   ///< the number of variants in the block
+	int Num_Plane;     ///< the number of bit planes in use
+	size_t Stride;     ///< the number of words per sample
+	vector<C_UInt64> Bits;  ///< valid, homozygote, allele planes per sample
+	double Mb[IBD_BLOCK_SIZE];        ///< the average M_{ij} per variant
+	double MbTotal[IBD_BLOCK_WORD];   ///< the sum of Mb per word
+	C_UInt64 FullMask[IBD_BLOCK_WORD];  ///< the variants in use
+
+	double *N, *D;
+	int Num_Thread;
+	vector< pair<int,int> > Tiles;
+
+	/// the sum of Mb over the variants in V
+	inline double MbSum(int w, C_UInt64 V) const
+	{
+		double s = MbTotal[w];
+		C_UInt64 miss = FullMask[w] & ~V;
+		while (miss)
+		{
+			s -= Mb[(w << 6) + CTZ_U64(miss)];
+			miss &= miss - 1;
+		}
+		return s;
+	}
+
+	/// the diagonal
+	inline void Diag(int i, size_t idx)
+	{
+		const C_UInt64 *p = &Bits[size_t(i) * Stride];
+		C_Int64 nValid=0, nHom=0;
+		double mb = 0;
+		for (int w=0; w < IBD_BLOCK_WORD; w++)
+		{
+			C_UInt64 V = p[w];
+			if (!V) continue;
+			nValid += POPCNT_U64(V);
+			nHom += POPCNT_U64(V & p[IBD_BLOCK_WORD + w]);
+			mb += MbSum(w, V);
+		}
+		N[idx] += nHom - mb;
+		D[idx] += nValid - mb;
+	}
+
+	/// a pair of different samples
+	inline void Pair(int i, int j, size_t idx)
+	{
+		const C_UInt64 *pi = &Bits[size_t(i) * Stride];
+		const C_UInt64 *pj = &Bits[size_t(j) * Stride];
+		C_Int64 nValid=0, nMatch=0;
+		double mb = 0;
+		for (int w=0; w < IBD_BLOCK_WORD; w++)
+		{
+			C_UInt64 V = pi[w] & pj[w];
+			if (!V) continue;
+			nValid += POPCNT_U64(V);
+			mb += MbSum(w, V);
+
+			C_UInt64 e00=V, e01=V, e10=V, e11=V;
+			const C_UInt64 *a = pi + 2*IBD_BLOCK_WORD + w;
+			const C_UInt64 *b = pj + 2*IBD_BLOCK_WORD + w;
+			for (int k=0; k < Num_Plane; k++)
+			{
+				C_UInt64 a0=a[0], a1=a[IBD_BLOCK_WORD];
+				C_UInt64 b0=b[0], b1=b[IBD_BLOCK_WORD];
+				e00 &= ~(a0 ^ b0); e01 &= ~(a0 ^ b1);
+				e10 &= ~(a1 ^ b0); e11 &= ~(a1 ^ b1);
+				a += 2*IBD_BLOCK_WORD; b += 2*IBD_BLOCK_WORD;
+			}
+			nMatch += POPCNT_U64(e00) + POPCNT_U64(e01) +
+				POPCNT_U64(e10) + POPCNT_U64(e11);
+		}
+		if (nValid > 0)
+		{
+			N[idx] += nMatch * 0.25 - mb;
+			D[idx] += nValid - mb;
+		}
+	}
+
+	/// process the tiles assigned to a thread
+	void DoTiles(int ThreadIndex)
+	{
+		const size_t n = Num_Sample;
+		for (size_t k=ThreadIndex; k < Tiles.size(); k += Num_Thread)
+		{
+			const int i0 = Tiles[k].first * IBD_TILE_SIZE;
+			const int i1 = min(i0 + IBD_TILE_SIZE, Num_Sample);
+			const int j0 = Tiles[k].second * IBD_TILE_SIZE;
+			const int j1 = min(j0 + IBD_TILE_SIZE, Num_Sample);
+			for (int i=i0; i < i1; i++)
+			{
+				// the index of (i, i) in the upper triangle
+				const size_t st = size_t(i)*n - size_t(i)*(i-1)/2;
+				int j = (j0 > i) ? j0 : i;
+				if (j == i)
+				{
+					Diag(i, st);
+					j ++;
+				}
+				for (; j < j1; j++)
+					Pair(i, j, st + (j - i));
+			}
+		}
+	}
+
+	static void Thread(PdThread Thread, int ThreadIndex, void *Param)
+	{
+		((CIBDOneLocus*)Param)->DoTiles(ThreadIndex);
+	}
+};
+
+
+
+extern "C"
+{
+// ===========================================================
+// IBD over one locus
+// ===========================================================
+
+/// Calculate the numerators and denominators of average IBD over loci
+COREARRAY_DLL_EXPORT SEXP SEQ_IBD_OneLocus(SEXP gdsfile, SEXP num_thread)
+{
+	int nThread = Rf_asInteger(num_thread);
+	if ((nThread == NA_INTEGER) || (nThread < 1)) nThread = 1;
+
+	COREARRAY_TRY
+
+		// the selection
+		TInitObject::TSelection &Sel = Init.Selection(gdsfile);
+		// the GDS root node
+		PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
+
+		// init selection
+		if (Sel.Sample.empty())
+		{
+			PdAbstractArray N = GDS_Node_Path(Root, "sample.id", TRUE);
+			int Cnt = GDS_Array_GetTotalCount(N);
+			if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'sample.id'.");
+			Sel.Sample.resize(Cnt, TRUE);
+		}
+		if (Sel.Variant.empty())
+		{
+			PdAbstractArray N = GDS_Node_Path(Root, "variant.id", TRUE);
+			int Cnt = GDS_Array_GetTotalCount(N);
+			if (Cnt < 0) throw ErrSeqArray("Invalid dimension of 'variant.id'.");
+			Sel.Variant.resize(Cnt, TRUE);
+		}
+
+		const size_t nSample = Sel.Sample.count();
+		const size_t size = nSample * (nSample + 1) / 2;
+		if (size > 2147483647)
+			throw ErrSeqArray("Too many samples.");
+
+		// m[,1] -- numerator, m[,2] -- denominator
+		rv_ans = PROTECT(Rf_allocMatrix(REALSXP, size, 2));
+		double *pN = REAL(rv_ans), *pD = REAL(rv_ans) + size;
+		memset(pN, 0, sizeof(double)*size*2);
+
+		if ((nSample > 0) && (Sel.Variant.count() > 0))
+		{
+			CVarApplyByVariant Reader;
+			Reader.InitObject(CVariable::ctGenotype, "genotype/data",
+				gdsfile, Sel.Variant, Sel.Sample, true);
+			if (Reader.DLen[2] != 2)
+				throw ErrSeqArray("Should be diploid.");
+			Reader.SetBlockRead(VARIANT_BLOCK_SIZE);
+
+			CIBDOneLocus IBD(nSample);
+			vector<C_UInt8> Geno(nSample * 2);
+			do {
+				Reader.ReadGenoData(&Geno[0]);
+				IBD.AddVariant(&Geno[0]);
+				if (IBD.IsFull())
+					IBD.Run(pN, pD, nThread);
+			} while (Reader.NextCell());
+			if (!IBD.IsEmpty())
+				IBD.Run(pN, pD, nThread);
+		}
+
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+} // extern "C"
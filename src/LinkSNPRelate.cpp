@@ -95,8 +95,7 @@ static void SNPRelate_InitSelSampOnly(C_BOOL *Sel, TParam *Param)
 	*Param->pSampleNum = sum;
 
 	TInitObject::TSelection &s = Init.Selection(Param->SeqGDSFile);
-	s.Sample.resize(*Param->pTotalSampleNum);
-	memcpy(&s.Sample[0], Sel, *Param->pTotalSampleNum);
+	s.Sample.assign(Sel, *Param->pTotalSampleNum);
 
 	Done_Object(Param);
 }
@@ -110,8 +109,7 @@ static void SNPRelate_InitSelSNPOnly(C_BOOL *Sel, TParam *Param)
 	*Param->pSNPNum = sum;
 
 	TInitObject::TSelection &s = Init.Selection(Param->SeqGDSFile);
-	s.Variant.resize(*Param->pTotalSNPNum);
-	memcpy(&s.Variant[0], Sel, *Param->pTotalSNPNum);
+	s.Variant.assign(Sel, *Param->pTotalSNPNum);
 
 	Done_Object(Param);
 }
@@ -127,11 +125,9 @@ static void SNPRelate_SnpRead(C_Int32 SnpStart, C_Int32 SnpCount,
 		Obj = new CVarApplyByVariant;
 		Param->Object = Obj;
 
-		PdGDSFolder Root = GDS_R_SEXP2FileRoot(Param->SeqGDSFile);
 		TInitObject::TSelection &Sel = Init.Selection(Param->SeqGDSFile);
 		Obj->InitObject(CVariable::ctGenotype,
-			"genotype/data", Root, Sel.Variant.size(),
-			&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0], true);
+			"genotype/data", Param->SeqGDSFile, Sel.Variant, Sel.Sample, true);
 
 		size_t SIZE = (Obj->Num_Sample) * (Obj->DLen[2]);
 		Param->GenoBuffer = new C_UInt8[SIZE];
@@ -215,8 +211,8 @@ static void SNPRelate_SampleRead(C_Int32 SampStart, C_Int32 SampCount,
 		PdGDSFolder Root = GDS_R_SEXP2FileRoot(Param->SeqGDSFile);
 		TInitObject::TSelection &Sel = Init.Selection(Param->SeqGDSFile);
 		Obj->InitObject(CVariable::ctGenotype,
-			"genotype/data", Root, Sel.Variant.size(),
-			&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0], false);
+			"genotype/data", Root, Sel.Variant, Sel.Sample, false);
+		Obj->SetBlockRead(SAMPLE_BLOCK_SIZE);
 
 		size_t SIZE = (Obj->Num_Variant) * (Obj->DLen[2]);
 		Param->GenoBuffer = new C_UInt8[SIZE];
@@ -236,52 +232,22 @@ static void SNPRelate_SampleRead(C_Int32 SampStart, C_Int32 SampCount,
 
 	for (int sn = SampCount; sn > 0; sn--)
 	{
-		Obj->ReadGenoData(Param->GenoBuffer);
+		// dosages of reference allele in 2 bits, 3 for missing genotypes
+		Obj->ReadGenoPacked(Param->GenoBuffer);
 		Obj->NextCell();
 		Param->Index ++;
 
+		const C_UInt8 *p = Param->GenoBuffer;
 		if (OutDim == RDim_SNP_X_Sample)
 		{
-			C_UInt8 *p = Param->GenoBuffer;
-			for (size_t n=Obj->Num_Variant; n > 0; n--)
-			{
-				C_UInt8 *pp = p;
-				p += Obj->DLen[2];
-				C_UInt8 val = 0;
-				for (size_t m=Obj->DLen[2]; m > 0; m--, pp++)
-				{
-					if (*pp == 0)
-					{
-						val ++;
-						if (val > 2) val = 2;
-					} else if (*pp == NA_RAW)
-					{
-						val = 3; break;
-					}
-				}
-				*OutBuf ++ = val;
-			}
-
+			for (int n=0; n < Obj->Num_Variant; n++)
+				*OutBuf ++ = (p[n >> 2] >> ((n & 0x03) << 1)) & 0x03;
 		} else {
 			C_UInt8 *g = (OutBuf ++);
-			C_UInt8 *p = Param->GenoBuffer;
-			for (size_t n=Obj->Num_Variant; n > 0; n--)
+			for (int n=0; n < Obj->Num_Variant; n++)
 			{
-				C_UInt8 *pp = p;
-				p += Obj->DLen[2];
-				C_UInt8 val = 0;
-				for (size_t m=Obj->DLen[2]; m > 0; m--, pp++)
-				{
-					if (*pp == 0)
-					{
-						val ++;
-						if (val > 2) val = 2;
-					} else if (*pp == NA_RAW)
-					{
-						val = 3; break;
-					}
-				}
-				*g = val; g += SampCount;
+				*g = (p[n >> 2] >> ((n & 0x03) << 1)) & 0x03;
+				g += SampCount;
 			}
 		}
 	}
@@ -290,17 +256,17 @@ static void SNPRelate_SampleRead(C_Int32 SampStart, C_Int32 SampCount,
 static void SNPRelate_SetSnpSelection(C_BOOL *sel, TParam *Param)
 {
 	TInitObject::TSelection &s = Init.Selection(Param->SeqGDSFile);
-	C_BOOL *p = &s.Variant[0];
+	CSelection &p = s.Variant;
 
 	int sum = 0;
-	for (int i=0; i < *Param->pTotalSNPNum; i++, p++)
+	for (int i=0; i < *Param->pTotalSNPNum; i++)
 	{
-		if (*p)
+		if (p[i])
 		{
 			if (*sel ++)
 				sum ++;
 			else
-				*p = FALSE;
+				p.set(i, false);
 		}
 	}
 	*Param->pSNPNum = sum;
@@ -311,17 +277,17 @@ static void SNPRelate_SetSnpSelection(C_BOOL *sel, TParam *Param)
 static void SNPRelate_SetSampSelection(C_BOOL *sel, TParam *Param)
 {
 	TInitObject::TSelection &s = Init.Selection(Param->SeqGDSFile);
-	C_BOOL *p = &s.Sample[0];
+	CSelection &p = s.Sample;
 
 	int sum = 0;
-	for (int i=0; i < *Param->pTotalSampleNum; i++, p++)
+	for (int i=0; i < *Param->pTotalSampleNum; i++)
 	{
-		if (*p)
+		if (p[i])
 		{
 			if (*sel ++)
 				sum ++;
 			else
-				*p = FALSE;
+				p.set(i, false);
 		}
 	}
 	*Param->pSampleNum = sum;
@@ -132,106 +132,132 @@ COREARRAY_DLL_EXPORT SEXP FC_AF_List(SEXP List)
 
 // ======================================================================
 
-static int AlleleFreq_Index = 0;
-static int *AlleleFreq_RefPtr = NULL;
-static SEXP AlleleFreq_Allele = R_NilValue;
+/// The context of allele frequencies with specified reference alleles
+struct COREARRAY_DLL_LOCAL TAlleleFreqContext
+{
+	int Index;                  ///< the index of the current variant
+	vector<int> RefIndex;       ///< the reference allele indices
+	vector<string> RefAllele;   ///< the reference allele strings
 
-/// Set the reference allele with an index
-COREARRAY_DLL_EXPORT SEXP FC_AF_SetIndex(SEXP RefIndex)
+	TAlleleFreqContext(): Index(0) { }
+
+	/// get the index of reference allele for the current variant
+	inline int RefOf(const char *allele)
+	{
+		if (!RefAllele.empty())
+		{
+			if (Index >= (int)RefAllele.size())
+				throw ErrSeqArray("Invalid length of 'ref.allele'.");
+			return GetIndexOfAllele(RefAllele[Index++].c_str(), allele);
+		} else if (RefIndex.size() == 1)
+		{
+			return (RefIndex[0] < GetNumOfAllele(allele)) ? RefIndex[0] : -1;
+		} else {
+			if (Index >= (int)RefIndex.size())
+				throw ErrSeqArray("Invalid length of 'ref.allele'.");
+			int ref = RefIndex[Index++];
+			return (ref < GetNumOfAllele(allele)) ? ref : -1;
+		}
+	}
+};
+
+static void AlleleFreq_Free(SEXP ptr)
 {
-	if (XLENGTH(RefIndex) == 1)
+	TAlleleFreqContext *p = (TAlleleFreqContext*)R_ExternalPtrAddr(ptr);
+	if (p)
 	{
-		AlleleFreq_Index = Rf_asInteger(RefIndex);
-		AlleleFreq_RefPtr = NULL;
-	} else {
-		AlleleFreq_Index = 0;
-		AlleleFreq_RefPtr = INTEGER(RefIndex);
+		delete p;
+		R_ClearExternalPtr(ptr);
 	}
-	return R_NilValue;
 }
 
-/// Get allele frequencies
-COREARRAY_DLL_EXPORT SEXP FC_AF_Index(SEXP List)
+static TAlleleFreqContext &AlleleFreq_Get(SEXP ptr)
 {
-	SEXP Geno = VECTOR_ELT(List, 0);
-	int *p = INTEGER(Geno);
-	int nAllele = GetNumOfAllele(CHAR(STRING_ELT(VECTOR_ELT(List, 1), 0)));
-	int n = 0, m = 0;
+	TAlleleFreqContext *p = NULL;
+	if (TYPEOF(ptr) == EXTPTRSXP)
+		p = (TAlleleFreqContext*)R_ExternalPtrAddr(ptr);
+	if (!p)
+		throw ErrSeqArray("Invalid context of allele frequencies.");
+	return *p;
+}
 
-	if (AlleleFreq_RefPtr == NULL)
+static SEXP AlleleFreq_New(TAlleleFreqContext *p)
+{
+	SEXP rv = PROTECT(R_MakeExternalPtr(p, R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(rv, AlleleFreq_Free, TRUE);
+	UNPROTECT(1);
+	return rv;
+}
+
+/// Calculate the frequency of reference allele, 'ref' is -1 if not found
+static double AlleleFreq_Calc(const int *p, size_t N, int ref)
+{
+	if (ref < 0) return R_NaN;
+	int n = 0, m = 0;
+	for (; N > 0; N--)
 	{
-		if (AlleleFreq_Index < nAllele)
+		int g = *p ++;
+		if (g != NA_INTEGER)
 		{
-			for (size_t N=XLENGTH(Geno); N > 0; N--)
-			{
-				int g = *p ++;
-				if (g != NA_INTEGER)
-				{
-					n ++;
-					if (g == AlleleFreq_Index)
-						m ++;
-				}
-			}
-		} else {
-			return ScalarReal(R_NaN);
+			n ++;
+			if (g == ref) m ++;
 		}
-	} else {
-		if (AlleleFreq_RefPtr[AlleleFreq_Index] < nAllele)
+	}
+	return (n > 0) ? (double(m) / n) : R_NaN;
+}
+
+
+/// Create a context with the reference allele indices
+COREARRAY_DLL_EXPORT SEXP FC_AF_SetIndex(SEXP RefIndex)
+{
+	COREARRAY_TRY
+		if (XLENGTH(RefIndex) <= 0)
+			throw ErrSeqArray("Invalid 'ref.allele'.");
+		TAlleleFreqContext *p = new TAlleleFreqContext;
+		if (XLENGTH(RefIndex) == 1)
 		{
-			for (size_t N=XLENGTH(Geno); N > 0; N--)
-			{
-				int g = *p ++;
-				if (g != NA_INTEGER)
-				{
-					n ++;
-					if (g == AlleleFreq_RefPtr[AlleleFreq_Index])
-						m ++;
-				}
-			}
-			AlleleFreq_Index ++;
+			p->RefIndex.push_back(Rf_asInteger(RefIndex));
 		} else {
-			AlleleFreq_Index ++;
-			return ScalarReal(R_NaN);
+			int *s = INTEGER(RefIndex);
+			p->RefIndex.assign(s, s + XLENGTH(RefIndex));
 		}
-	}
+		rv_ans = AlleleFreq_New(p);
+	COREARRAY_CATCH
+}
 
-	return ScalarReal((n > 0) ? (double(m) / n) : R_NaN);
+/// Get allele frequencies
+COREARRAY_DLL_EXPORT SEXP FC_AF_Index(SEXP List, SEXP Context)
+{
+	COREARRAY_TRY
+		SEXP Geno = VECTOR_ELT(List, 0);
+		int ref = AlleleFreq_Get(Context).RefOf(
+			CHAR(STRING_ELT(VECTOR_ELT(List, 1), 0)));
+		rv_ans = ScalarReal(AlleleFreq_Calc(INTEGER(Geno), XLENGTH(Geno), ref));
+	COREARRAY_CATCH
 }
 
-/// Set the reference allele with string
+/// Create a context with the reference allele strings
 COREARRAY_DLL_EXPORT SEXP FC_AF_SetAllele(SEXP RefAllele)
 {
-	AlleleFreq_Allele = RefAllele;
-	AlleleFreq_Index = 0;
-	return R_NilValue;
+	COREARRAY_TRY
+		TAlleleFreqContext *p = new TAlleleFreqContext;
+		const R_xlen_t n = XLENGTH(RefAllele);
+		p->RefAllele.resize(n);
+		for (R_xlen_t i=0; i < n; i++)
+			p->RefAllele[i] = CHAR(STRING_ELT(RefAllele, i));
+		rv_ans = AlleleFreq_New(p);
+	COREARRAY_CATCH
 }
 
 /// Get allele frequencies
-COREARRAY_DLL_EXPORT SEXP FC_AF_Allele(SEXP List)
+COREARRAY_DLL_EXPORT SEXP FC_AF_Allele(SEXP List, SEXP Context)
 {
-	SEXP Geno = VECTOR_ELT(List, 0);
-	int *p = INTEGER(Geno);
-	int idx = GetIndexOfAllele(
-		CHAR(STRING_ELT(AlleleFreq_Allele, AlleleFreq_Index)),
-		CHAR(STRING_ELT(VECTOR_ELT(List, 1), 0)));
-	AlleleFreq_Index ++;
-
-	if (idx >= 0)
-	{
-		int n = 0, m = 0;
-		for (size_t N=XLENGTH(Geno); N > 0; N--)
-		{
-			int g = *p ++;
-			if (g != NA_INTEGER)
-			{
-				n ++;
-				if (g == idx)
-					m ++;
-			}
-		}
-		return ScalarReal((n > 0) ? (double(m) / n) : R_NaN);
-	} else
-		return ScalarReal(R_NaN);
+	COREARRAY_TRY
+		SEXP Geno = VECTOR_ELT(List, 0);
+		int ref = AlleleFreq_Get(Context).RefOf(
+			CHAR(STRING_ELT(VECTOR_ELT(List, 1), 0)));
+		rv_ans = ScalarReal(AlleleFreq_Calc(INTEGER(Geno), XLENGTH(Geno), ref));
+	COREARRAY_CATCH
 }
 
 
@@ -331,106 +357,70 @@ COREARRAY_DLL_EXPORT SEXP FC_IBD_Div(SEXP NumeratorDenominator, SEXP N)
 
 #define MISSING    0x7F
 
-/// Calculate average IBD over loci
-COREARRAY_DLL_EXPORT SEXP FC_IBD_OneLocus(SEXP Geno, SEXP NumeratorDenominator,
-	SEXP M_ij)
+/// The context of IBD over two loci, a ring buffer of genotypes
+struct COREARRAY_DLL_LOCAL TIBDTwoLociContext
 {
-	int *pdim = INTEGER(getAttrib(Geno, R_DimSymbol));
-	int num_ploidy=pdim[0], num_sample=pdim[1];
-	if (num_ploidy != 2)
-		error("Should be diploid.");
-
-	C_Int8 *pM = (C_Int8*)RAW(M_ij);
-	Rbyte *g_i = RAW(Geno);
-	C_Int64 Sum = 0;
-	int nSum = 0;
+	vector<Rbyte> GenoBuffer;  ///< the genotypes of the previous variants
+	int Interval;              ///< the interval between two loci
+	int Start;                 ///< the number of buffered variants
+	int Index;                 ///< the position in the ring buffer
+};
 
-	for (int i=0; i < num_sample; i++, g_i+=2)
-	{
-		if ((g_i[0] != NA_RAW) && (g_i[1] != NA_RAW))
-		{
-			*pM ++ = (g_i[0] == g_i[1]) ? 4 : 0;  // 4 * M_i
-			Rbyte *g_j = g_i + 2;
-
-			for (int j=i+1; j < num_sample; j++, g_j+=2)
-			{
-				if ((g_j[0] != NA_RAW) && (g_j[1] != NA_RAW))
-				{
-					C_Int8 val = 0;  // 4 * M_{ij}
-					if (g_i[0] == g_j[0]) val++;
-					if (g_i[0] == g_j[1]) val++;
-					if (g_i[1] == g_j[0]) val++;
-					if (g_i[1] == g_j[1]) val++;
-					*pM ++ = val;
-					Sum += val; nSum ++;
-				} else
-					*pM ++ = MISSING;
-			}
-		} else {
-			for (int j=i; j < num_sample; j++)
-				*pM ++ = MISSING;
-		}
-	}
-
-	if (nSum > 0)
+static void IBD_TwoLoci_Free(SEXP ptr)
+{
+	TIBDTwoLociContext *p = (TIBDTwoLociContext*)R_ExternalPtrAddr(ptr);
+	if (p)
 	{
-		size_t n = size_t(num_sample) * (num_sample + 1) / 2;
-		double Mb = (double)Sum / nSum * 0.25;
-		double OneMb = 1 - Mb;
-		double *pN = REAL(NumeratorDenominator);
-		double *pD = REAL(NumeratorDenominator) + n;
-		C_Int8 *pM = (C_Int8*)RAW(M_ij);
-		for (; n > 0; n--)
-		{
-			if (*pM != MISSING)
-			{
-				*pN += (*pM) * 0.25 - Mb;
-				*pD += OneMb;
-			}
-			pN ++; pD ++; pM ++;
-		}
+		delete p;
+		R_ClearExternalPtr(ptr);
 	}
-
-	return R_NilValue;
 }
 
-
-static vector<Rbyte> IBD_TwoLoci_GenoBuffer;
-static int IBD_TwoLoci_Interval;
-static int IBD_TwoLoci_Interval_Start;
-static int IBD_TwoLoci_Interval_Index;
-
+/// Create a context of IBD over two loci
 COREARRAY_DLL_EXPORT SEXP FC_IBD_TwoLoci_Init(SEXP interval, SEXP num_samp)
 {
-	IBD_TwoLoci_Interval = Rf_asInteger(interval);
-	if (IBD_TwoLoci_Interval <= 0)
+	int Interval = Rf_asInteger(interval);
+	if ((Interval == NA_INTEGER) || (Interval <= 0))
 		error("Invalid 'interval'.");
-	IBD_TwoLoci_Interval_Start = 0;
-	IBD_TwoLoci_Interval_Index = 0;
-	IBD_TwoLoci_GenoBuffer.resize(Rf_asInteger(num_samp)*2*IBD_TwoLoci_Interval);
-	return R_NilValue;
+
+	TIBDTwoLociContext *p = new TIBDTwoLociContext;
+	p->Interval = Interval;
+	p->Start = p->Index = 0;
+	p->GenoBuffer.resize(size_t(Rf_asInteger(num_samp))*2*Interval);
+
+	SEXP rv = PROTECT(R_MakeExternalPtr(p, R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(rv, IBD_TwoLoci_Free, TRUE);
+	UNPROTECT(1);
+	return rv;
 }
 
 /// Calculate average IBD over loci
 COREARRAY_DLL_EXPORT SEXP FC_IBD_TwoLoci(SEXP Geno, SEXP NumeratorDenominator,
-	SEXP M_ij)
+	SEXP M_ij, SEXP Context)
 {
+	TIBDTwoLociContext *ctx = NULL;
+	if (TYPEOF(Context) == EXTPTRSXP)
+		ctx = (TIBDTwoLociContext*)R_ExternalPtrAddr(Context);
+	if (!ctx)
+		error("Invalid context of IBD.");
+
 	const int *pdim = INTEGER(getAttrib(Geno, R_DimSymbol));
 	const int num_ploidy=pdim[0], num_sample=pdim[1];
 	const size_t size = num_sample * 2;
 	if (num_ploidy != 2)
 		error("Should be diploid.");
+	if (ctx->GenoBuffer.size() != size * ctx->Interval)
+		error("Invalid context of IBD.");
 
-	if (IBD_TwoLoci_Interval_Start < IBD_TwoLoci_Interval)
+	if (ctx->Start < ctx->Interval)
 	{
-		memcpy(&IBD_TwoLoci_GenoBuffer[size * IBD_TwoLoci_Interval_Start],
-			RAW(Geno), size);
-		IBD_TwoLoci_Interval_Start ++;
+		memcpy(&ctx->GenoBuffer[size * ctx->Start], RAW(Geno), size);
+		ctx->Start ++;
 		return R_NilValue;
 	}
 
 	C_Int8 *pM = (C_Int8*)RAW(M_ij);
-	Rbyte *g1_i = &IBD_TwoLoci_GenoBuffer[size * IBD_TwoLoci_Interval_Index];
+	Rbyte *g1_i = &ctx->GenoBuffer[size * ctx->Index];
 	Rbyte *g2_i = RAW(Geno);
 	C_Int64 Sum = 0;
 	int nSum = 0;
@@ -489,11 +479,10 @@ COREARRAY_DLL_EXPORT SEXP FC_IBD_TwoLoci(SEXP Geno, SEXP NumeratorDenominator,
 	}
 
 	// copy genotype to the buffer
-	memcpy(&IBD_TwoLoci_GenoBuffer[size * IBD_TwoLoci_Interval_Index],
-		RAW(Geno), size);
-	IBD_TwoLoci_Interval_Index ++;
-	if (IBD_TwoLoci_Interval_Index >= IBD_TwoLoci_Interval)
-		IBD_TwoLoci_Interval_Index = 0;
+	memcpy(&ctx->GenoBuffer[size * ctx->Index], RAW(Geno), size);
+	ctx->Index ++;
+	if (ctx->Index >= ctx->Interval)
+		ctx->Index = 0;
 
 	return R_NilValue;
 }
@@ -0,0 +1,489 @@
+// ===========================================================
+//
+// ReadByChunk.cpp: Read data chunk by chunk of variants
+//
+// Copyright (C) 2015    Xiuwen Zheng
+//
+// This file is part of SeqArray.
+//
+// SeqArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// SeqArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SeqArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "ReadByVariant.h"
+
+
+// ===================================================================== //
+
+/// a cursor over the selected variants, returning a chunk at a time
+class COREARRAY_DLL_LOCAL CVarChunkCursor: public CVarApply
+{
+public:
+	CVarChunkCursor(SEXP gdsfile, SEXP var_name, int chunk, bool useraw);
+	~CVarChunkCursor();
+
+	/// read the next chunk, or return R_NilValue if no more variant
+	SEXP Next(SEXP gdsfile);
+	/// move to the first selected variant
+	void Reset();
+
+	/// the number of selected variants
+	inline int NumVariant() const { return nVariant; }
+	/// the number of variants returned
+	inline int NumDone() const { return nDone; }
+
+private:
+	/// a variable in the cursor
+	struct TVar
+	{
+		string Name;                ///< the variable name
+		TType Type;                 ///< the type of variable
+		PdAbstractArray Node;       ///< the GDS variable
+		TInitObject::TIndex *Index; ///< the offsets if variable-length
+		int DimCnt;                 ///< the number of dimensions
+		C_Int32 DLen[3];            ///< the dimensions
+		CVarApplyByVariant *Geno;   ///< the genotype reader
+		/// the output type of genotypes
+		CVarApplyByVariant::TGenoOut GenoOut;
+		bool Alt;                   ///< dosages of alternate alleles
+	};
+
+	vector<TVar> VarList;       ///< the list of variables
+	CSelection VariantSel;      ///< the variant selection when opening
+	CSelection SampleSel;       ///< the sample selection when opening
+	vector<C_BOOL> VariantBuf;  ///< the variant selection of a chunk in reading GDS
+	vector<C_BOOL> SampleBuf;   ///< the sample selection in reading GDS
+	int nVariant;               ///< the number of selected variants
+	int nSample;                ///< the number of selected samples
+	int ChunkSize;              ///< the max number of variants per chunk
+	int CurIndex;               ///< the raw index of the next chunk
+	int nDone;                  ///< the number of variants returned
+	vector<C_UInt8> BufU8;      ///< the buffer in unpacking genotypes
+	vector<int> BufI32;         ///< the buffer in unpacking genotypes
+
+	void InitVarList(SEXP gdsfile, SEXP var_name, bool useraw);
+	void FreeGeno();
+	SEXP ReadGeno(TVar &V, int n);
+	SEXP ReadVar(TVar &V, C_Int32 Start, C_Int32 Count);
+};
+
+
+CVarChunkCursor::CVarChunkCursor(SEXP gdsfile, SEXP var_name, int chunk,
+	bool useraw)
+{
+	static const char *ErrDim = "Invalid dimension of '%s'.";
+
+	// the selection
+	TInitObject::TSelection &Sel = Init.Selection(gdsfile);
+	// the GDS root node
+	PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
+
+	// snapshot of the current selection
+	PdAbstractArray N = GDS_Node_Path(Root, "sample.id", TRUE);
+	int Cnt = GDS_Array_GetTotalCount(N);
+	if (Cnt < 0) throw ErrSeqArray(ErrDim, "sample.id");
+	if (Sel.Sample.empty())
+		SampleSel.resize(Cnt, true);
+	else if ((int)Sel.Sample.size() == Cnt)
+		SampleSel = Sel.Sample;
+	else
+		throw ErrSeqArray(ErrDim, "sample.id");
+	N = GDS_Node_Path(Root, "variant.id", TRUE);
+	Cnt = GDS_Array_GetTotalCount(N);
+	if (Cnt <= 0) throw ErrSeqArray(ErrDim, "variant.id");
+	if (Sel.Variant.empty())
+		VariantSel.resize(Cnt, true);
+	else if ((int)Sel.Variant.size() == Cnt)
+		VariantSel = Sel.Variant;
+	else
+		throw ErrSeqArray(ErrDim, "variant.id");
+	nVariant = VariantSel.count();
+	nSample = SampleSel.count();
+	ChunkSize = chunk;
+
+	VarList.resize(Rf_length(var_name));
+	for (int i=0; i < (int)VarList.size(); i++)
+		VarList[i].Geno = NULL;
+	try {
+		InitVarList(gdsfile, var_name, useraw);
+	} catch (...) {
+		FreeGeno();
+		throw;
+	}
+
+	Reset();
+}
+
+CVarChunkCursor::~CVarChunkCursor()
+{
+	FreeGeno();
+}
+
+void CVarChunkCursor::FreeGeno()
+{
+	for (int i=0; i < (int)VarList.size(); i++)
+	{
+		if (VarList[i].Geno)
+			{ delete VarList[i].Geno; VarList[i].Geno = NULL; }
+	}
+}
+
+void CVarChunkCursor::InitVarList(SEXP gdsfile, SEXP var_name, bool useraw)
+{
+	static const char *ErrDim = "Invalid dimension of '%s'.";
+	PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
+
+	for (int i=0; i < (int)VarList.size(); i++)
+	{
+		TVar &V = VarList[i];
+		string s = V.Name = CHAR(STRING_ELT(var_name, i));
+		V.Index = NULL;
+		memset(V.DLen, 0, sizeof(V.DLen));
+		V.Alt = false;
+		V.GenoOut = CVarApplyByVariant::goInt32;
+
+		if ( s=="variant.id" || s=="position" || s=="chromosome" ||
+			s=="allele" || s=="annotation/id" || s=="annotation/qual" ||
+			s=="annotation/filter" )
+		{
+			V.Type = ctBasic;
+		} else if ((s=="genotype") || (s=="$dosage") || (s=="$dosage_alt"))
+		{
+			V.Type = ctGenotype;
+			V.Alt = (s == "$dosage_alt");
+			if (s == "genotype")
+			{
+				V.GenoOut = useraw ? CVarApplyByVariant::goRaw :
+					CVarApplyByVariant::goInt32;
+			} else {
+				V.GenoOut = useraw ? CVarApplyByVariant::goDosageRaw :
+					CVarApplyByVariant::goDosageInt32;
+			}
+			s = "genotype/data";
+		} else if (s == "phase")
+		{
+			V.Type = ctPhase;
+			s = "phase/data";
+		} else if (strncmp(s.c_str(), "annotation/info/", 16) == 0)
+		{
+			V.Type = ctInfo;
+		} else if (strncmp(s.c_str(), "annotation/format/", 18) == 0)
+		{
+			V.Type = ctFormat;
+			s.append("/data");
+		} else {
+			throw ErrSeqArray(
+				"'%s' is not a standard variable name, and the standard format:\n"
+				"\tvariant.id, position, chromosome, allele, genotype, phase\n"
+				"\t$dosage, $dosage_alt\n"
+				"\tannotation/id, annotation/qual, annotation/filter\n"
+				"\tannotation/info/VARIABLE_NAME, annotation/format/VARIABLE_NAME",
+				s.c_str());
+		}
+
+		if (V.Type == ctGenotype)
+		{
+			// a reader for each variable, moving chunk by chunk
+			if (nSample <= 0)
+				throw ErrSeqArray("There is no selected sample.");
+			V.Geno = new CVarApplyByVariant;
+			V.Geno->InitObject(ctGenotype, s.c_str(), gdsfile,
+				VariantSel, SampleSel, false);
+			V.Geno->SetBlockRead(VARIANT_BLOCK_SIZE);
+			continue;
+		}
+		GDS_PATH_PREFIX_CHECK(s.c_str());
+		V.Node = GDS_Node_Path(Root, s.c_str(), TRUE);
+		V.DimCnt = GDS_Array_DimCnt(V.Node);
+		if ((V.DimCnt < 1) || (V.DimCnt > 3))
+			throw ErrSeqArray(ErrDim, s.c_str());
+		GDS_Array_GetDim(V.Node, V.DLen, V.DimCnt);
+		if ((V.Type == ctPhase) || (V.Type == ctFormat))
+		{
+			if ((V.DimCnt < 2) || (V.DLen[1] != (int)SampleSel.size()))
+				throw ErrSeqArray(ErrDim, s.c_str());
+			if (SampleBuf.empty())
+				SampleSel.view(SampleBuf);
+		}
+
+		// variable-length data
+		if ((V.Type == ctInfo) || (V.Type == ctFormat))
+		{
+			string s2 = GDS_PATH_PREFIX(s, '@');
+			PdAbstractArray I = GDS_Node_Path(Root, s2.c_str(), FALSE);
+			if (I != NULL)
+			{
+				if ((GDS_Array_DimCnt(I) != 1) ||
+						(GDS_Array_GetTotalCount(I) != (C_Int64)VariantSel.size()))
+					throw ErrSeqArray(ErrDim, s2.c_str());
+				V.Index = &Init.Index(gdsfile, s2.c_str(), I);
+			} else if (V.Type == ctFormat)
+				throw ErrSeqArray("'%s' is missing!", s2.c_str());
+		}
+		if (!V.Index && (V.DLen[0] != (int)VariantSel.size()))
+			throw ErrSeqArray(ErrDim, s.c_str());
+	}
+}
+
+void CVarChunkCursor::Reset()
+{
+	CurIndex = 0;
+	nDone = 0;
+	for (int i=0; i < (int)VarList.size(); i++)
+	{
+		if (VarList[i].Geno)
+			VarList[i].Geno->ResetObject();
+	}
+}
+
+SEXP CVarChunkCursor::ReadGeno(TVar &V, int n)
+{
+	CVarApplyByVariant &Geno = *V.Geno;
+	const size_t SIZE = Geno.GenoOutSize(V.GenoOut);
+	const bool IsInt = (V.GenoOut == CVarApplyByVariant::goInt32) ||
+		(V.GenoOut == CVarApplyByVariant::goDosageInt32);
+	const size_t nVal = IsInt ? SIZE / sizeof(int) : SIZE;
+
+	// a new R object for each chunk, since the previous one may be kept
+	SEXP ans = IsInt ? NEW_INTEGER(R_xlen_t(nVal) * n) :
+		NEW_RAW(R_xlen_t(nVal) * n);
+	PROTECT(ans);
+	SEXP dim;
+	if (V.GenoOut == CVarApplyByVariant::goInt32 ||
+		V.GenoOut == CVarApplyByVariant::goRaw)
+	{
+		PROTECT(dim = NEW_INTEGER(3));
+		INTEGER(dim)[0] = Geno.DLen[2];
+		INTEGER(dim)[1] = nSample;
+		INTEGER(dim)[2] = n;
+	} else {
+		PROTECT(dim = NEW_INTEGER(2));
+		INTEGER(dim)[0] = nSample;
+		INTEGER(dim)[1] = n;
+	}
+	SET_DIM(ans, dim);
+	UNPROTECT(1);
+
+	// genotypes of the variants in the chunk
+	C_UInt8 *base = IsInt ? (C_UInt8*)INTEGER(ans) : RAW(ans);
+	bool RawWarn = false;
+	for (int i=0; i < n; i++)
+	{
+		int nPlane;
+		const C_UInt8 *g = Geno.ReadGenoRaw(nPlane);
+		if (!Geno.UnpackGeno(base, V.GenoOut, V.Alt, g, nPlane, BufU8, BufI32))
+			RawWarn = true;
+		base += SIZE;
+		Geno.NextCell();
+	}
+	if (RawWarn)
+		warning("RAW type may not be sufficient to store genotypes.");
+
+	UNPROTECT(1);
+	return ans;
+}
+
+SEXP CVarChunkCursor::ReadVar(TVar &V, C_Int32 Start, C_Int32 Count)
+{
+	C_Int32 st[3] = { Start, 0, 0 };
+	C_Int32 cnt[3] = { Count, V.DLen[1], V.DLen[2] };
+	VariantBuf.resize(Count);
+	C_BOOL *sel[3] = { NULL, NULL, NULL };
+	if (Count > 0)
+	{
+		VariantSel.get(Start, Count, &VariantBuf[0]);
+		sel[0] = &VariantBuf[0];
+	}
+	vector<C_BOOL> RawSel;
+	vector<int> Len;
+
+	if (V.Index)
+	{
+		// map to the raw indices of variable-length data
+		const C_Int64 *pOff = &(V.Index->Offset[Start]);
+		V.Index->GetRange(Start, Count, st[0], cnt[0]);
+		for (int i=0; i < Count; i++)
+		{
+			int L = pOff[i+1] - pOff[i];
+			if (VariantBuf[i])
+				Len.push_back(L);
+			RawSel.insert(RawSel.end(), L, VariantBuf[i]);
+		}
+		sel[0] = RawSel.empty() ? NULL : &RawSel[0];
+	}
+	C_BOOL *True = NeedTRUE((V.DLen[1] > V.DLen[2]) ? V.DLen[1] : V.DLen[2]);
+	if (V.DimCnt > 1)
+	{
+		if ((V.Type==ctPhase) || (V.Type==ctFormat))
+			sel[1] = SampleBuf.empty() ? NULL : &SampleBuf[0];
+		else
+			sel[1] = True;
+	}
+	if (V.DimCnt > 2)
+		sel[2] = True;
+
+	SEXP ans;
+	if (cnt[0] > 0)
+	{
+		PROTECT(ans = GDS_R_Array_Read(V.Node, st, cnt, sel, 0));
+	} else {
+		// no data in the chunk
+		PROTECT(ans = NEW_INTEGER(0));
+	}
+	char classname[32];
+	classname[0] = 0;
+	GDS_Node_GetClassName(V.Node, classname, sizeof(classname));
+	if (strcmp(classname, "dBit1") == 0)
+	{
+		ans = AS_LOGICAL(ans);
+		UNPROTECT(1);
+		PROTECT(ans);
+	}
+
+	if (V.Index)
+	{
+		SEXP rv, I32, nm;
+		PROTECT(rv = NEW_LIST(2));
+		PROTECT(I32 = NEW_INTEGER(Len.size()));
+		for (int i=0; i < (int)Len.size(); i++)
+			INTEGER(I32)[i] = Len[i];
+		SET_ELEMENT(rv, 0, I32);
+		SET_ELEMENT(rv, 1, ans);
+		PROTECT(nm = NEW_CHARACTER(2));
+		SET_STRING_ELT(nm, 0, mkChar("length"));
+		SET_STRING_ELT(nm, 1, mkChar("data"));
+		SET_NAMES(rv, nm);
+		UNPROTECT(4);
+		return rv;
+	}
+
+	UNPROTECT(1);
+	return ans;
+}
+
+SEXP CVarChunkCursor::Next(SEXP gdsfile)
+{
+	// check whether the file is still open
+	GDS_R_SEXP2FileRoot(gdsfile);
+
+	// the raw index range of the chunk
+	CurIndex = VariantSel.next(CurIndex);
+	if (CurIndex >= (int)VariantSel.size()) return R_NilValue;
+	int n = nVariant - nDone;
+	if (n > ChunkSize) n = ChunkSize;
+	int End = VariantSel.skip(CurIndex, n);
+
+	SEXP ans = PROTECT(NEW_LIST(VarList.size()));
+	for (int i=0; i < (int)VarList.size(); i++)
+	{
+		TVar &V = VarList[i];
+		if (V.Type == ctGenotype)
+			SET_ELEMENT(ans, i, ReadGeno(V, n));
+		else
+			SET_ELEMENT(ans, i, ReadVar(V, CurIndex, End - CurIndex));
+	}
+	UNPROTECT(1);
+
+	CurIndex = End;
+	nDone += n;
+	return ans;
+}
+
+
+/// free the cursor
+static void Chunk_Free(SEXP ptr)
+{
+	CVarChunkCursor *p = (CVarChunkCursor*)R_ExternalPtrAddr(ptr);
+	if (p)
+	{
+		delete p;
+		R_ClearExternalPtr(ptr);
+	}
+}
+
+/// get the cursor
+static CVarChunkCursor &Chunk_Get(SEXP ptr)
+{
+	CVarChunkCursor *p = NULL;
+	if (TYPEOF(ptr) == EXTPTRSXP)
+		p = (CVarChunkCursor*)R_ExternalPtrAddr(ptr);
+	if (!p)
+		throw ErrSeqArray("The chunk cursor has been closed.");
+	return *p;
+}
+
+
+
+extern "C"
+{
+// ===========================================================
+// Read data chunk by chunk of variants
+// ===========================================================
+
+/// open a chunk cursor over the selected variants
+COREARRAY_DLL_EXPORT SEXP SEQ_Chunk_Open(SEXP gdsfile, SEXP var_name,
+	SEXP chunk_size, SEXP use_raw)
+{
+	int chunk = Rf_asInteger(chunk_size);
+	if ((chunk == NA_INTEGER) || (chunk < 1))
+		error("'chunk.size' should be a positive integer.");
+	int raw_flag = Rf_asLogical(use_raw);
+	if (raw_flag == NA_LOGICAL)
+		error("'.useraw' must be TRUE or FALSE.");
+
+	COREARRAY_TRY
+
+		CVarChunkCursor *p = new CVarChunkCursor(gdsfile, var_name, chunk,
+			raw_flag == TRUE);
+		// keep the file object with the pointer
+		rv_ans = PROTECT(R_MakeExternalPtr(p, R_NilValue, gdsfile));
+		R_RegisterCFinalizerEx(rv_ans, Chunk_Free, TRUE);
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+/// get the next chunk, or NULL if no more variant
+COREARRAY_DLL_EXPORT SEXP SEQ_Chunk_Next(SEXP cursor)
+{
+	COREARRAY_TRY
+
+		CVarChunkCursor &C = Chunk_Get(cursor);
+		rv_ans = C.Next(R_ExternalPtrProtected(cursor));
+
+	COREARRAY_CATCH
+}
+
+/// move the cursor to the first variant, and return the progress
+COREARRAY_DLL_EXPORT SEXP SEQ_Chunk_Info(SEXP cursor, SEXP reset)
+{
+	COREARRAY_TRY
+
+		CVarChunkCursor &C = Chunk_Get(cursor);
+		if (Rf_asLogical(reset) == TRUE)
+			C.Reset();
+		rv_ans = NEW_INTEGER(2);
+		INTEGER(rv_ans)[0] = C.NumDone();
+		INTEGER(rv_ans)[1] = C.NumVariant();
+
+	COREARRAY_CATCH
+}
+
+/// close the cursor
+COREARRAY_DLL_EXPORT SEXP SEQ_Chunk_Close(SEXP cursor)
+{
+	Chunk_Free(cursor);
+	R_SetExternalPtrProtected(cursor, R_NilValue);
+	return R_NilValue;
+}
+
+} // extern "C"
@@ -20,18 +20,17 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "ReadBySample.h"
+#include "vectorization.h"
 
 
-static void GetFirstAndLength(C_BOOL *sel, size_t n, C_Int32 &st, C_Int32 &len)
+static void GetFirstAndLength(const CSelection &sel, C_Int32 &st, C_Int32 &len)
 {
 	st = 0; len = 0;
-	for (size_t i=0; i < n; i++)
+	size_t i = sel.next(0);
+	if (i < sel.size())
 	{
-		if (sel[i]) { st = i; break; }
-	}
-	for (ssize_t i=n-1; i >= 0; i--)
-	{
-		if (sel[i]) { len = i - st + 1; break; }
+		st = i;
+		len = sel.last() - i + 1;
 	}
 }
 
@@ -39,14 +38,21 @@ static void GetFirstAndLength(C_BOOL *sel, size_t n, C_Int32 &st, C_Int32 &len)
 CVarApplyBySample::CVarApplyBySample()
 {
 	Node = NULL;
-	SampleSelect = NULL;
+	UseRaw = UsePacked = false;
+	PlaneCount = 0;
+	BlockSize = 0;
+	BlockStart = BlockEnd = 0;
+	WinMaxVariant = WinMaxPlane = 0;
+	MaxBuffer = SAMPLE_BLOCK_MAX_BUFFER;
 }
 
 void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
-	int nVariant, C_BOOL *VariantSel, int nSample, C_BOOL *SampleSel,
-	bool _UseRaw)
+	const CSelection &VariantSel, const CSelection &SampleSel,
+	bool _UseRaw, size_t _MaxBuffer)
 {
 	static const char *ErrDim = "Invalid dimension of '%s'.";
+	const int nVariant = VariantSel.size();
+	const int nSample = SampleSel.size();
 
 	// initialize
 	GDS_PATH_PREFIX_CHECK(Path);
@@ -72,9 +78,13 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 
 	TotalNum_Sample = nSample;
 	SampleSelect = SampleSel;
-	Num_Variant = GetNumOfTRUE(VariantSel, nVariant);
+	Num_Variant = VariantSel.count();
 	UseRaw = _UseRaw;
+	UsePacked = false;
 	NumOfBits = GDS_Array_GetBitOf(Node);
+	BlockSize = 0;
+	BlockStart = BlockEnd = 0;
+	MaxBuffer = (_MaxBuffer > 0) ? _MaxBuffer : 1;
 
 	string Path2; // the path with '@'
 	PdAbstractArray IndexNode = NULL;  // the corresponding index variable
@@ -109,11 +119,12 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 
 			{
 				C_Int32 I, Cnt;
-				GetFirstAndLength(VariantSel, nVariant, I, Cnt);
+				GetFirstAndLength(VariantSel, I, Cnt);
 				C_Int32 II=0, ICnt=I+Cnt;
-				vector<C_UInt8> ILen(ICnt);
+				vector<C_Int32> ILen(ICnt);
 
-				GDS_Array_ReadData(IndexNode, &II, &ICnt, &ILen[0], svUInt8);
+				if (ICnt > 0)
+					GDS_Array_ReadData(IndexNode, &II, &ICnt, &ILen[0], svInt32);
 
 				VariantStart = 0;
 				for (int i=0; i < I; i++) VariantStart += ILen[i];
@@ -123,32 +134,65 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 				Selection.resize(VariantCount);
 				GenoCellCnt.resize(Num_Variant);
 
-				C_BOOL *p = &Selection[0];
-				C_UInt8 *p8 = &GenoCellCnt[0];
-				CellCount = 0;
+				// split the variants into windows of bounded bit planes
+				WinVariant.assign(1, 0);
+				WinRaw.assign(1, 0);
+				WinMaxVariant = WinMaxPlane = 0;
+
+				C_BOOL *p = Selection.empty() ? NULL : &Selection[0];
+				C_Int32 *pCnt = GenoCellCnt.empty() ? NULL : &GenoCellCnt[0];
+				C_Int32 k=0, r=0;
+				size_t nPlane = 0;
+				PlaneCount = 0;
 				for (int i=I; i < ICnt; i++)
 				{
 					C_BOOL flag = VariantSel[i];
 					int m = ILen[i];
 					if (flag)
 					{
-						if ((m <= 0) || (m > 255))
+						if (m <= 0)
 						{
-							throw ErrSeqArray("Invalid '%s': should be 1..255.",
+							throw ErrSeqArray("Invalid '%s': should be > 0.",
 								Path2.c_str());
 						}
-						CellCount += m;
-						*p8 ++ = m;
+						if (m * NumOfBits > 31)
+						{
+							throw ErrSeqArray(
+								"Invalid '%s': %d bit planes of %d bits exceed an integer.",
+								Path2.c_str(), m, NumOfBits);
+						}
+						size_t n = size_t(m) * DLen[2];
+						if ((nPlane > 0) && (nPlane + n > MaxBuffer))
+						{
+							if (WinMaxPlane < nPlane) WinMaxPlane = nPlane;
+							WinVariant.push_back(k);
+							WinRaw.push_back(r);
+							nPlane = 0;
+						}
+						nPlane += n;
+						PlaneCount += n;
+						pCnt[k++] = m;
 					}
+					r += ILen[i];
 					for (; m > 0; m--) *p++ = flag;
 				}
+				if (k > WinVariant.back())
+				{
+					if (WinMaxPlane < nPlane) WinMaxPlane = nPlane;
+					WinVariant.push_back(k);
+					WinRaw.push_back(r);
+				}
+				for (size_t i=1; i < WinVariant.size(); i++)
+				{
+					size_t n = WinVariant[i] - WinVariant[i-1];
+					if (WinMaxVariant < n) WinMaxVariant = n;
+				}
 			}
 
-			CellCount *= DLen[2];
-			Init.Need_GenoBuffer(CellCount);
+			CellCount = size_t(Num_Variant) * DLen[2];
 
 			SelPtr[0] = NeedTRUE(1);
-			SelPtr[1] = &Selection[0];
+			SelPtr[1] = Selection.empty() ? NULL : &Selection[0];
 			SelPtr[2] = NeedTRUE(DLen[2]);
 			break;
 
@@ -163,8 +207,11 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 
 			CellCount = Num_Variant;
 			SelPtr[0] = NeedTRUE(1);
-			GetFirstAndLength(VariantSel, nVariant, VariantStart, VariantCount);
-			SelPtr[1] = VariantSel + VariantStart;
+			GetFirstAndLength(VariantSel, VariantStart, VariantCount);
+			Selection.resize(VariantCount);
+			VariantSel.get(VariantStart, VariantCount,
+				Selection.empty() ? NULL : &Selection[0]);
+			SelPtr[1] = Selection.empty() ? NULL : &Selection[0];
 			if (DimCnt > 2)
 			{
 				CellCount *= DLen[2];
@@ -189,11 +236,12 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 
 			{
 				C_Int32 I, Cnt;
-				GetFirstAndLength(VariantSel, nVariant, I, Cnt);
+				GetFirstAndLength(VariantSel, I, Cnt);
 				C_Int32 II=0, ICnt=I+Cnt;
 				vector<C_Int32> ILen(ICnt);
 
-				GDS_Array_ReadData(IndexNode, &II, &ICnt, &ILen[0], svInt32);
+				if (ICnt > 0)
+					GDS_Array_ReadData(IndexNode, &II, &ICnt, &ILen[0], svInt32);
 
 				VariantStart = 0;
 				for (int i=0; i < I; i++) VariantStart += ILen[i];
@@ -201,7 +249,7 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 				for (int i=I; i < ICnt; i++) VariantCount += ILen[i];
 
 				Selection.resize(VariantCount);
-				C_BOOL *p = &Selection[0];
+				C_BOOL *p = Selection.empty() ? NULL : &Selection[0];
 				CellCount = 0;
 				for (int i=I; i < ICnt; i++)
 				{
@@ -221,7 +269,7 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 			}
 
 			SelPtr[0] = NeedTRUE(1);
-			SelPtr[1] = &Selection[0];
+			SelPtr[1] = Selection.empty() ? NULL : &Selection[0];
 			if (DimCnt > 2)
 			{
 				SelPtr[2] = NeedTRUE(DLen[2]);
@@ -258,106 +306,191 @@ void CVarApplyBySample::InitObject(TType Type, const char *Path, PdGDSObj Root,
 
 void CVarApplyBySample::ResetObject()
 {
-	CurIndex = 0;
-	if (!SampleSelect[0]) NextCell();
+	CurIndex = SampleSelect.next(0);
 }
 
 bool CVarApplyBySample::NextCell()
 {
-	CurIndex ++;
-	while ((CurIndex<TotalNum_Sample) && !SampleSelect[CurIndex])
-		CurIndex ++;
+	CurIndex = SampleSelect.next(CurIndex + 1);
 	return (CurIndex < TotalNum_Sample);
 }
 
-void CVarApplyBySample::ReadGenoData(int *Base)
+void CVarApplyBySample::SetBlockRead(int nSample)
 {
-	C_Int32 st[3] = { CurIndex, VariantStart, 0 };
-	C_Int32 cn[3] = { 1, VariantCount, DLen[2] };
-	C_UInt8 *s = &Init.GENO_BUFFER[0];
-
-	GDS_Array_ReadDataEx(Node, st, cn, SelPtr, s, svUInt8);
-	const int bit_mask = ~((-1) << NumOfBits);
-
-	for (int i=0; i < Num_Variant; i++)
+	if (VarType == ctGenotype)
 	{
-		int *p;
-		int missing = bit_mask;
-
-		// the first 2 bits
-		p = Base;
-		for (int j=DLen[2]; j > 0; j--)
-			*p++ = *s++;
-
-		/// the left bits
-		C_UInt8 shift = NumOfBits;
-		for (int m=GenoCellCnt[i]; m > 1; m--)
+		BlockSize = (nSample > 0) ? nSample : 0;
+		BlockStart = BlockEnd = 0;
+		if (BlockSize <= 0)
 		{
-			p = Base;
-			for (int j=DLen[2]; j > 0; j--)
-			{
-				*p |= int(*s) << shift;
-				p ++; s ++;
-			}
-			shift += NumOfBits;
-			missing = (missing << NumOfBits) | bit_mask;
-		}
-
-		for (int j=DLen[2]; j > 0; j--)
-		{
-			if (*Base == missing) *Base = NA_INTEGER;
-			Base ++;
+			vector<C_UInt8> tmp;
+			BlockGeno.swap(tmp);
 		}
 	}
 }
 
-void CVarApplyBySample::ReadGenoData(C_UInt8 *Base)
+void CVarApplyBySample::SetPacked(bool packed)
+{
+	if (packed && (VarType != ctGenotype))
+		throw ErrSeqArray("Packed dosages are only available for genotypes.");
+	UsePacked = packed;
+}
+
+void CVarApplyBySample::LoadGenoBlock()
 {
-	C_Int32 st[3] = { CurIndex, VariantStart, 0 };
-	C_Int32 cn[3] = { 1, VariantCount, DLen[2] };
-	C_UInt8 *s = &Init.GENO_BUFFER[0];
+	// the number of samples in the block, limited by the buffer size
+	size_t MaxCnt = BlockSize;
+	if ((PlaneCount > 0) && (MaxCnt*PlaneCount > MaxBuffer))
+		MaxCnt = MaxBuffer / PlaneCount;
+	if (MaxCnt < 1) MaxCnt = 1;
+
+	// determine the rows of selected samples in the block
+	BlockRow.clear();
+	size_t n = 0;
+	C_Int32 i = CurIndex;
+	for (; (i < TotalNum_Sample) && (n < MaxCnt); i++)
+	{
+		if (SampleSelect[i])
+			BlockRow.push_back(n++);
+		else
+			BlockRow.push_back(-1);
+	}
 
-	GDS_Array_ReadDataEx(Node, st, cn, SelPtr, s, svUInt8);
-	const int bit_mask = ~((-1) << NumOfBits);
+	// read genotypes of the selected samples, a sample-major tile
+	if (n*PlaneCount > 0)
+	{
+		if (BlockGeno.size() < n*PlaneCount)
+			BlockGeno.resize(n*PlaneCount);
+		C_Int32 st[3] = { CurIndex, VariantStart, 0 };
+		C_Int32 cn[3] = { i - CurIndex, VariantCount, DLen[2] };
+		BlockSel.resize(i - CurIndex);
+		SampleSelect.get(CurIndex, i - CurIndex, &BlockSel[0]);
+		C_BOOL *sel[3] = { &BlockSel[0], SelPtr[1], SelPtr[2] };
+		GDS_Array_ReadDataEx(Node, st, cn, sel, &BlockGeno[0], svUInt8);
+	}
+
+	BlockStart = CurIndex;
+	BlockEnd = i;
+}
 
-	for (int i=0; i < Num_Variant; i++)
+C_UInt8 *CVarApplyBySample::ReadGenoPlanes(size_t iWin)
+{
+	// all variants in one window, a block of samples
+	if ((BlockSize > 0) && (WinVariant.size() == 2))
 	{
-		C_UInt8 *p;
-		int missing = bit_mask;
+		if ((CurIndex < BlockStart) || (CurIndex >= BlockEnd))
+			LoadGenoBlock();
+		return &BlockGeno[BlockRow[CurIndex - BlockStart] * PlaneCount];
+	}
 
-		// the first 2 bits
-		p = Base;
-		for (int j=DLen[2]; j > 0; j--)
-			*p++ = *s++;
+	// read the window of variants for the current sample
+	if (BlockGeno.size() < WinMaxPlane)
+		BlockGeno.resize(WinMaxPlane);
+	C_Int32 r = WinRaw[iWin];
+	C_Int32 st[3] = { CurIndex, VariantStart + r, 0 };
+	C_Int32 cn[3] = { 1, WinRaw[iWin+1] - r, DLen[2] };
+	C_BOOL *sel[3] = { SelPtr[0], SelPtr[1] + r, SelPtr[2] };
+	GDS_Array_ReadDataEx(Node, st, cn, sel, &BlockGeno[0], svUInt8);
+	return &BlockGeno[0];
+}
+
+bool CVarApplyBySample::MergeGeno(size_t iWin, int *I32, C_UInt8 *U8,
+	bool Clamp)
+{
+	const C_UInt8 *s = ReadGenoPlanes(iWin);
+	const C_Int32 *pCnt = GenoCellCnt.empty() ? NULL : &GenoCellCnt[0];
+	const int iEnd = WinVariant[iWin+1];
+	bool sufficient = true;
 
-		if (NumOfBits == 2)
+	// variants with one bit plane are contiguous, merge them in one pass
+	for (int i=WinVariant[iWin]; i < iEnd; )
+	{
+		int m = pCnt[i], j = i + 1;
+		if (m == 1)
+			while ((j < iEnd) && (pCnt[j] == 1)) j ++;
+		size_t n = size_t(j - i) * DLen[2];
+		if (I32)
+		{
+			vec_geno_merge_i32(I32, s, n, m, NumOfBits);
+			I32 += n;
+		} else if (size_t(m) * NumOfBits <= 8)
+		{
+			vec_geno_merge_u8(U8, s, n, m, NumOfBits);
+			U8 += n;
+		} else if (Clamp)
 		{
-			if (GenoCellCnt[i] > 4)
-				warning("RAW type may not be sufficient to store genotypes.");
+			if (PackedGenoI32.size() < n)
+				PackedGenoI32.resize(n);
+			int *p = &PackedGenoI32[0];
+			vec_geno_merge_i32(p, s, n, m, NumOfBits);
+			for (size_t k=n; k > 0; k--, p++)
+				*U8++ = (*p == NA_INTEGER) ? NA_RAW : ((*p == 0) ? 0 : 1);
 		} else {
-			if (GenoCellCnt[i] > 1)
-				warning("RAW type may not be sufficient to store genotypes.");
+			vec_geno_merge_u8(U8, s, n, (NumOfBits >= 8) ? 1 : m, NumOfBits);
+			U8 += n;
+			sufficient = false;
 		}
+		s += n * m;
+		i = j;
+	}
 
-		/// the left bits
-		C_UInt8 shift = NumOfBits;
-		for (int m=GenoCellCnt[i]; m > 1; m--)
-		{
-			p = Base;
-			for (int j=DLen[2]; j > 0; j--)
-			{
-				*p |= int(*s) << shift;
-				p ++; s ++;
-			}
-			shift += NumOfBits;
-			missing = (missing << NumOfBits) | bit_mask;
-		}
+	return sufficient;
+}
 
-		for (int j=DLen[2]; j > 0; j--)
-		{
-			if (*Base == missing) *Base = NA_RAW;
-			Base ++;
-		}
+void CVarApplyBySample::ReadGenoData(int *Base)
+{
+	for (size_t w=0; w+1 < WinVariant.size(); w++)
+	{
+		MergeGeno(w, Base, NULL, false);
+		Base += size_t(WinVariant[w+1] - WinVariant[w]) * DLen[2];
+	}
+}
+
+void CVarApplyBySample::ReadGenoData(C_UInt8 *Base)
+{
+	bool sufficient = true;
+	for (size_t w=0; w+1 < WinVariant.size(); w++)
+	{
+		if (!MergeGeno(w, NULL, Base, false))
+			sufficient = false;
+		Base += size_t(WinVariant[w+1] - WinVariant[w]) * DLen[2];
+	}
+	if (!sufficient)
+		warning("RAW type may not be sufficient to store genotypes.");
+}
+
+void CVarApplyBySample::ReadGenoPacked(C_UInt8 *Base)
+{
+	const size_t nCell = WinMaxVariant * DLen[2];
+	if (PackedGeno.size() < nCell)
+		PackedGeno.resize(nCell);
+	if (DosageGeno.size() < size_t(Num_Variant))
+		DosageGeno.resize(Num_Variant);
+
+	// alleles in bytes window by window, only reference or not is needed
+	for (size_t w=0; w+1 < WinVariant.size(); w++)
+	{
+		MergeGeno(w, NULL, &PackedGeno[0], true);
+		vec_dosage_u8(&DosageGeno[WinVariant[w]], &PackedGeno[0],
+			WinVariant[w+1] - WinVariant[w], DLen[2]);
+	}
+
+	// 2 bits per variant, no more than 2 and 3 for missing
+	const C_UInt8 *d = DosageGeno.empty() ? NULL : &DosageGeno[0];
+	C_UInt8 b = 0;
+	int i = 0;
+	for (; i < Num_Variant; i++, d++)
+	{
+		C_UInt8 val = (*d == NA_RAW) ? 3 : ((*d > 2) ? 2 : *d);
+		b |= val << ((i & 0x03) << 1);
+		if ((i & 0x03) == 0x03)
+			{ *Base++ = b; b = 0; }
+	}
+	if (i & 0x03)
+	{
+		for (; i & 0x03; i++)
+			b |= 0x03 << ((i & 0x03) << 1);
+		*Base = b;
 	}
 }
 
@@ -365,7 +498,9 @@ void CVarApplyBySample::ReadData(SEXP Val)
 {
 	if (VarType == ctGenotype)
 	{
-		if (UseRaw)
+		if (UsePacked)
+			ReadGenoPacked(RAW(Val));
+		else if (UseRaw)
 			ReadGenoData(RAW(Val));
 		else
 			ReadGenoData(INTEGER(Val));
@@ -399,7 +534,9 @@ SEXP CVarApplyBySample::NeedRData(int &nProtected)
 		{
 			if (VarType == ctGenotype)
 			{
-				if (UseRaw)
+				if (UsePacked)
+					PROTECT(ans = NEW_RAW(PackedSize()));
+				else if (UseRaw)
 					PROTECT(ans = NEW_RAW(CellCount));
 				else
 					PROTECT(ans = NEW_INTEGER(CellCount));
@@ -434,6 +571,7 @@ SEXP CVarApplyBySample::NeedRData(int &nProtected)
 		switch (VarType)
 		{
 		case ctGenotype:
+			if (UsePacked) break;
 			PROTECT(dim = NEW_INTEGER(2));
 			INTEGER(dim)[0] = DLen[2]; INTEGER(dim)[1] = Num_Variant;
 			SET_DIM(ans, dim);
@@ -485,12 +623,21 @@ extern "C"
 
 /// Apply functions over margins on a working space
 COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Sample(SEXP gdsfile, SEXP var_name,
-	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP rho)
+	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP use_packed,
+	SEXP buf_size, SEXP rho)
 {
 	int use_raw_flag = Rf_asLogical(use_raw);
 	if (use_raw_flag == NA_LOGICAL)
 		error("'.useraw' must be TRUE or FALSE.");
 
+	int packed_flag = Rf_asLogical(use_packed);
+	if (packed_flag == NA_LOGICAL)
+		error("'.packed' must be TRUE or FALSE.");
+
+	double buf_bytes = Rf_asReal(buf_size);
+	if (!R_FINITE(buf_bytes) || (buf_bytes < 1))
+		error("'seqarray.sample.buffer' should be a positive number.");
+
 	COREARRAY_TRY
 
 		// the selection
@@ -518,7 +665,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Sample(SEXP gdsfile, SEXP var_name,
 		int nProtected = 0;
 
 		// the number of selected variants
-		int nSample = GetNumOfTRUE(&Sel.Sample[0], Sel.Sample.size());
+		int nSample = Sel.Sample.count();
 		if (nSample <= 0)
 			throw ErrSeqArray("There is no selected sample.");
 
@@ -562,9 +709,11 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Sample(SEXP gdsfile, SEXP var_name,
 					s.c_str());
 			}
 
-			NodeList[i].InitObject(VarType, s.c_str(), Root, Sel.Variant.size(),
-				&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0],
-				use_raw_flag != FALSE);
+			NodeList[i].InitObject(VarType, s.c_str(), Root, Sel.Variant,
+				Sel.Sample, use_raw_flag != FALSE, (size_t)buf_bytes);
+			NodeList[i].SetBlockRead(SAMPLE_BLOCK_SIZE);
+			if (VarType == CVarApplyBySample::ctGenotype)
+				NodeList[i].SetPacked(packed_flag != FALSE);
 		}
 
 		// ===============================================================
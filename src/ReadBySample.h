@@ -22,7 +22,15 @@
 #include "Common.h"
 
 
-/// 
+// ===================================================================== //
+
+/// the default number of samples per block in reading genotypes
+#define SAMPLE_BLOCK_SIZE            64
+/// the default max size of genotype buffer in a block or a window of variants
+#define SAMPLE_BLOCK_MAX_BUFFER      (64*1024*1024)
+
+
+/// Object for reading a variable sample by sample
 class COREARRAY_DLL_LOCAL CVarApplyBySample: public CVarApply
 {
 protected:
@@ -31,17 +39,47 @@ protected:
 	C_Int32 VariantStart;   ///< start index according to the variants
 	C_Int32 VariantCount;   ///< the length according to the variants
 	size_t CellCount;       ///< the number of entries for the current sample
-	vector<C_UInt8> GenoCellCnt;  ///< 
+	size_t PlaneCount;      ///< the number of bytes of genotype bit planes per sample
+	vector<C_Int32> GenoCellCnt;  ///< the number of bit planes per selected variant
 	map<size_t, SEXP> VarList;    ///< a list of SEXP variables
 
 	C_SVType SVType;        ///< data type for GDS reading
 	C_BOOL *SelPtr[3];      ///< pointers to selection
-	C_BOOL *SampleSelect;   ///< pointer to sample selection
+	CSelection SampleSelect;  ///< the sample selection
 	bool UseRaw;            ///< whether use RAW type
+	bool UsePacked;         ///< whether use 2-bit packed dosages for genotypes
 
 	vector<C_BOOL> Selection;  ///< the buffer of selection
 	int NumOfBits;             ///< the number of bits
 
+	int BlockSize;          ///< the max number of samples per block, 0 for no block
+	C_Int32 BlockStart;     ///< the first sample index in the block
+	C_Int32 BlockEnd;       ///< the sample index after the block
+	vector<C_BOOL> BlockSel;     ///< the sample selection of the block
+	vector<C_UInt8> BlockGeno;   ///< sample-major genotypes of the selected samples
+	vector<C_Int32> BlockRow;    ///< rows in BlockGeno for samples in the block
+	vector<C_UInt8> PackedGeno;  ///< the genotype buffer for packed dosages
+	vector<int> PackedGenoI32;   ///< the genotype buffer for wide alleles
+	vector<C_UInt8> DosageGeno;  ///< the dosage buffer for packed dosages
+
+	vector<C_Int32> WinVariant;  ///< the first selected variant of each window
+	vector<C_Int32> WinRaw;      ///< the first raw index of each window
+	size_t WinMaxVariant;   ///< the max number of selected variants in a window
+	size_t WinMaxPlane;     ///< the max number of bytes of bit planes in a window
+	size_t MaxBuffer;       ///< the max size of genotype buffer in bytes
+
+	/// load genotypes of a run of selected samples starting from CurIndex
+	void LoadGenoBlock();
+	/// get bit planes of the current sample in the iWin-th window of variants
+	C_UInt8 *ReadGenoPlanes(size_t iWin);
+	/// merge bit planes of the current sample in the iWin-th window
+	/** \param I32    the output in 32-bit integers, or NULL
+	 *  \param U8     the output in bytes if I32 is NULL
+	 *  \param Clamp  if true, U8 is 0 for reference allele and 1 for others
+	 *  \return false if RAW type is not sufficient to store alleles
+	**/
+	bool MergeGeno(size_t iWin, int *I32, C_UInt8 *U8, bool Clamp);
+
 public:
 	TType VarType;          ///< VCF data type
 	int TotalNum_Sample;    ///< the total number of samples
@@ -56,16 +94,25 @@ public:
 	virtual ~CVarApplyBySample() {}
 
 	void InitObject(TType Type, const char *Path, PdGDSObj Root,
-		int nVariant, C_BOOL *VariantSel, int nSample, C_BOOL *SampleSel,
-		bool _UseRaw);
+		const CSelection &VariantSel, const CSelection &SampleSel,
+		bool _UseRaw, size_t _MaxBuffer=SAMPLE_BLOCK_MAX_BUFFER);
 	void ResetObject();
 
+	/// enable block reading of genotypes, nSample = 0 to disable
+	void SetBlockRead(int nSample);
+	/// return genotypes as 2-bit packed dosages of reference allele
+	void SetPacked(bool packed);
+
 	bool NextCell();
 
 	/// read genotypes in 32-bit integer
 	void ReadGenoData(int *Base);
 	/// read genotypes in unsigned 8-bit intetger
 	void ReadGenoData(C_UInt8 *Base);
+	/// read dosages of reference allele in 2 bits, 4 variants per byte
+	void ReadGenoPacked(C_UInt8 *Base);
+	/// the number of bytes of packed dosages per sample
+	inline size_t PackedSize() const { return (Num_Variant + 3) / 4; }
 
 	void ReadData(SEXP Val);
 
@@ -77,5 +124,6 @@ public:
 extern "C"
 {
 COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Sample(SEXP gdsfile, SEXP var_name,
-	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP rho);
+	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP use_packed,
+	SEXP buf_size, SEXP rho);
 } // extern "C"
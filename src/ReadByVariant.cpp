@@ -20,6 +20,7 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "ReadByVariant.h"
+#include "vectorization.h"
 
 
 // ===================================================================== //
@@ -28,27 +29,37 @@
 CVarApplyByVariant::CVarApplyByVariant()
 {
 	Node = IndexNode = NULL;
-	VariantSelect = NULL;
-	UseRaw = false;
+	Index = NULL;
+	UseRaw = UsePacked = false;
+	BlockSize = 0;
+	BlockStart = BlockEnd = 0;
 }
 
 void CVarApplyByVariant::InitObject(TType Type, const char *Path,
-	PdGDSObj Root, int nVariant, C_BOOL *VariantSel, int nSample,
-	C_BOOL *SampleSel, bool _UseRaw)
+	SEXP gdsfile, const CSelection &VariantSel, const CSelection &SampleSel,
+	bool _UseRaw)
 {
 	static const char *ErrDim = "Invalid dimension of '%s'.";
 
 	// initialize
 	GDS_PATH_PREFIX_CHECK(Path);
+	PdGDSObj Root = GDS_R_SEXP2FileRoot(gdsfile);
 	VarType = Type;
+	IndexNode = NULL;
+	Index = NULL;
 	Node = GDS_Node_Path(Root, Path, TRUE);
 	SVType = GDS_Array_GetSVType(Node);
 	DimCnt = GDS_Array_DimCnt(Node);
 
+	const int nVariant = VariantSel.size();
+	const int nSample = SampleSel.size();
 	TotalNum_Variant = nVariant;
 	VariantSelect = VariantSel;
-	Num_Sample = GetNumOfTRUE(SampleSel, nSample);
+	SampleSelect = SampleSel;
+	Num_Sample = SampleSel.count();
+	SampleBuf.clear();
 	UseRaw = _UseRaw;
+	UsePacked = false;
 	NumOfBits = GDS_Array_GetBitOf(Node);
 
 	string Path2; // the path with '@'
@@ -84,10 +95,9 @@ void CVarApplyByVariant::InitObject(TType Type, const char *Path,
 				Selection.resize(DLen[1] * DLen[2]);
 				C_BOOL *p = SelPtr[1] = &Selection[0];
 				memset(p, TRUE, Selection.size());
-				C_BOOL *s = SampleSel;
-				for (int n=DLen[1]; n > 0; n--)
+				for (int n=0; n < DLen[1]; n++)
 				{
-					if (*s++ == FALSE)
+					if (!SampleSel[n])
 					{
 						for (int m=DLen[2]; m > 0; m--)
 							*p ++ = FALSE;
@@ -95,6 +105,8 @@ void CVarApplyByVariant::InitObject(TType Type, const char *Path,
 						p += DLen[2];
 				}
 			}
+			// for reading a block of variants
+			SampleSel.view(SampleBuf);
 			break;
 
 		case ctPhase:
@@ -106,7 +118,7 @@ void CVarApplyByVariant::InitObject(TType Type, const char *Path,
 			if ((DLen[0] != nVariant) || (DLen[1] != nSample))
 				throw ErrSeqArray(ErrDim, Path);
 
-			SelPtr[1] = SampleSel;
+			SelPtr[1] = SampleSel.view(SampleBuf);
 			if (DimCnt > 2)
 				SelPtr[2] = NeedTRUE(DLen[2]);
 			break;
@@ -149,7 +161,7 @@ void CVarApplyByVariant::InitObject(TType Type, const char *Path,
 			} else
 				throw ErrSeqArray("'%s' is missing!", Path2.c_str());
 
-			SelPtr[1] = SampleSel;
+			SelPtr[1] = SampleSel.view(SampleBuf);
 			if (DimCnt > 2)
 				SelPtr[2] = NeedTRUE(DLen[2]);
 			break;
@@ -158,6 +170,9 @@ void CVarApplyByVariant::InitObject(TType Type, const char *Path,
 			throw ErrSeqArray("Internal Error in 'CVarApplyByVariant::InitObject'.");
 	}
 
+	if (IndexNode)
+		Index = &Init.Index(gdsfile, Path2.c_str(), IndexNode);
+
 	ResetObject();
 }
 
@@ -165,43 +180,100 @@ void CVarApplyByVariant::ResetObject()
 {
 	CurIndex = 0;
 	IndexRaw = 0;
-	if (IndexNode)
+	BlockStart = BlockEnd = 0;
+	if (Index)
 	{
-		C_Int32 Cnt=1;
-		GDS_Array_ReadData(IndexNode, &CurIndex, &Cnt, &NumIndexRaw, svInt32);
-		if (NumIndexRaw < 0) NumIndexRaw = 0;
+		Index->GetRange(0, (TotalNum_Variant > 0) ? 1 : 0, IndexRaw,
+			NumIndexRaw);
 	} else
 		NumIndexRaw = 1;
 
-	if (!VariantSelect[0])
+	if ((TotalNum_Variant > 0) && !VariantSelect[0])
 		NextCell();
 }
 
-bool CVarApplyByVariant::NextCell()
+void CVarApplyByVariant::SetBlockRead(int nVariant)
 {
-	CurIndex ++;
-
-	if (IndexNode)
+	if (VarType == ctGenotype)
 	{
-		IndexRaw += NumIndexRaw;
-		C_Int32 Cnt=1, L;
-		while ((CurIndex<TotalNum_Variant) && !VariantSelect[CurIndex])
+		BlockSize = (nVariant > 0) ? nVariant : 0;
+		BlockStart = BlockEnd = 0;
+		if (BlockSize <= 0)
 		{
-			GDS_Array_ReadData(IndexNode, &CurIndex, &Cnt, &L, svInt32);
-			if (L > 0)
-				IndexRaw += L;
-			CurIndex ++;
+			vector<C_UInt8> tmp;
+			BlockGeno.swap(tmp);
 		}
-		if (CurIndex < TotalNum_Variant)
+	}
+}
+
+void CVarApplyByVariant::SetPacked(bool packed)
+{
+	if (packed && (VarType != ctGenotype))
+		throw ErrSeqArray("Packed dosages are only available for genotypes.");
+	UsePacked = packed;
+}
+
+void CVarApplyByVariant::LoadGenoBlock()
+{
+	// the number of variants in the block
+	C_Int32 Cnt = TotalNum_Variant - CurIndex;
+	if (Cnt > BlockSize) Cnt = BlockSize;
+	const C_Int64 *pOff = &(Index->Offset[CurIndex]);
+	C_Int32 RawStart, RawCnt;
+	Index->GetRange(CurIndex, Cnt, RawStart, RawCnt);
+
+	// determine the variants in the block, and the selection of raw indices
+	BlockOffset.resize(Cnt);
+	BlockSel.clear();
+	BlockSel.reserve(RawCnt);
+	size_t nCell = 0;
+	C_Int32 n = 0;
+	for (; n < Cnt; n++)
+	{
+		int L = pOff[n+1] - pOff[n];
+		C_BOOL flag = VariantSelect[CurIndex + n];
+		if (flag)
 		{
-			GDS_Array_ReadData(IndexNode, &CurIndex, &Cnt, &NumIndexRaw,
-				svInt32);
-			if (NumIndexRaw < 0) NumIndexRaw = 0;
-		} else
-			NumIndexRaw = 0;
+			size_t m = L * CellCount;
+			if ((n > 0) && (nCell + m > VARIANT_BLOCK_MAX_BUFFER))
+				break;
+			BlockOffset[n] = nCell;
+			nCell += m;
+		}
+		BlockSel.insert(BlockSel.end(), L, flag);
+	}
+
+	// read genotypes of the selected variants in the block
+	if (nCell > 0)
+	{
+		if (BlockGeno.size() < nCell)
+			BlockGeno.resize(nCell);
+		C_Int32 st[3] = { IndexRaw, 0, 0 };
+		C_Int32 cnt[3] = { (C_Int32)BlockSel.size(), DLen[1], DLen[2] };
+		C_BOOL *sel[3] = { &BlockSel[0], &SampleBuf[0], NeedTRUE(DLen[2]) };
+		GDS_Array_ReadDataEx(Node, st, cnt, sel, &BlockGeno[0], svUInt8);
+	}
+
+	BlockStart = CurIndex;
+	BlockEnd = CurIndex + n;
+}
+
+C_UInt8 *CVarApplyByVariant::GenoBlock()
+{
+	if ((CurIndex < BlockStart) || (CurIndex >= BlockEnd))
+		LoadGenoBlock();
+	return &BlockGeno[BlockOffset[CurIndex - BlockStart]];
+}
+
+bool CVarApplyByVariant::NextCell()
+{
+	CurIndex = VariantSelect.next(CurIndex + 1);
+
+	if (Index)
+	{
+		Index->GetRange(CurIndex, (CurIndex < TotalNum_Variant) ? 1 : 0,
+			IndexRaw, NumIndexRaw);
 	} else {
-		while ((CurIndex<TotalNum_Variant) && !VariantSelect[CurIndex])
-			CurIndex ++;
 		IndexRaw = CurIndex;
 		NumIndexRaw = 1;
 	}
@@ -209,96 +281,129 @@ bool CVarApplyByVariant::NextCell()
 	return (CurIndex < TotalNum_Variant);
 }
 
-void CVarApplyByVariant::ReadGenoData(int *Base)
+C_UInt8 *CVarApplyByVariant::ReadGenoPlanes(int nPlane)
 {
-	// the size of Init.GENO_BUFFER has been checked in 'Init()'
+	if (nPlane * NumOfBits > 31)
+	{
+		throw ErrSeqArray(
+			"Invalid 'genotype/data': %d bit planes of %d bits exceed an integer.",
+			nPlane, NumOfBits);
+	}
+	if (BlockSize > 0)
+		return GenoBlock();
+
+	// read planes one by one from the GDS variable
 	const ssize_t SlideCnt = ssize_t(DLen[1]) * ssize_t(DLen[2]);
+	Init.Need_GenoBuffer(CellCount * (nPlane > 0 ? nPlane : 1));
+	C_UInt8 *p = &Init.GENO_BUFFER[0];
 
 	// NumIndexRaw always >= 1
 	CdIterator it;
 	GDS_Iter_Position(Node, &it, C_Int64(IndexRaw)*SlideCnt);
-	GDS_Iter_RDataEx(&it, Base, SlideCnt, svInt32, SelPtr[1]);
-
-	const int bit_mask = ~((-1) << NumOfBits);
-	int missing = bit_mask;
-	for (int idx=1; idx < NumIndexRaw; idx ++)
+	GDS_Iter_RDataEx(&it, p, SlideCnt, svUInt8, SelPtr[1]);
+	for (int idx=1; idx < nPlane; idx ++)
 	{
+		p += CellCount;
 		GDS_Iter_Position(Node, &it, (C_Int64(IndexRaw) + idx)*SlideCnt);
-		GDS_Iter_RDataEx(&it, &Init.GENO_BUFFER[0], SlideCnt, svUInt8, SelPtr[1]);
-
-		int shift = idx * NumOfBits;
-		C_UInt8 *s = &Init.GENO_BUFFER[0];
-		int *p = Base;
-		for (int n=Num_Sample; n > 0 ; n--)
-		{
-			for (int m=DLen[2]; m > 0 ; m--)
-				*p++ |= int(*s++) << shift;
-		}
-
-		missing = (missing << NumOfBits) | bit_mask;
+		GDS_Iter_RDataEx(&it, p, SlideCnt, svUInt8, SelPtr[1]);
 	}
 
+	return &Init.GENO_BUFFER[0];
+}
+
+void CVarApplyByVariant::ReadGenoData(int *Base)
+{
+	// merge bit planes and replace missing values in one pass
 	// CellCount = Num_Sample * DLen[2] in 'NeedRData'
-	for (size_t n=CellCount; n > 0; n--)
-	{
-		if (*Base == missing) *Base = NA_INTEGER;
-		Base ++;
-	}	
+	vec_geno_merge_i32(Base, ReadGenoPlanes(NumIndexRaw), CellCount,
+		NumIndexRaw, NumOfBits);
 }
 
-void CVarApplyByVariant::ReadGenoData(C_UInt8 *Base)
+const C_UInt8 *CVarApplyByVariant::ReadGenoRaw(int &nPlane)
 {
-	// the size of Init.GENO_BUFFER has been checked in 'Init()'
-	const ssize_t SlideCnt = ssize_t(DLen[1]) * ssize_t(DLen[2]);
+	nPlane = NumIndexRaw;
+	return ReadGenoPlanes(NumIndexRaw);
+}
 
-	// NumIndexRaw always >= 1
-	CdIterator it;
-	GDS_Iter_Position(Node, &it, C_Int64(IndexRaw)*SlideCnt);
-	GDS_Iter_RDataEx(&it, Base, SlideCnt, svUInt8, SelPtr[1]);
+size_t CVarApplyByVariant::GenoOutSize(TGenoOut Type) const
+{
+	switch (Type)
+	{
+		case goInt32:        return CellCount * sizeof(int);
+		case goRaw:          return CellCount;
+		case goDosageInt32:  return Num_Sample * sizeof(int);
+		case goDosageRaw:    return Num_Sample;
+		case goDosagePacked: return PackedSize();
+	}
+	return 0;
+}
 
-	const C_UInt8 bit_mask = ~((-1) << NumOfBits);
-	C_UInt8 missing = bit_mask;
-	int MyNumIndexRaw = NumIndexRaw;
-	switch (NumOfBits)
+bool CVarApplyByVariant::UnpackGeno(void *Out, TGenoOut Type, bool Alt,
+	const C_UInt8 *Planes, int nPlane, vector<C_UInt8> &BufU8,
+	vector<int> &BufI32) const
+{
+	if (Type == goInt32)
 	{
-	case 2:
-		if (NumIndexRaw > 4)
-			warning("RAW type may not be sufficient to store genotypes.");
-		break;
-	case 4:
-		if (NumIndexRaw > 2)
-			warning("RAW type may not be sufficient to store genotypes.");
-		break;
-	case 8:
-		MyNumIndexRaw = 1;
-		if (NumIndexRaw > 1)
-			warning("RAW type may not be sufficient to store genotypes.");
-		break;
+		vec_geno_merge_i32((int*)Out, Planes, CellCount, nPlane, NumOfBits);
+		return true;
+	}
+	if (Type == goRaw)
+	{
+		vec_geno_merge_u8((C_UInt8*)Out, Planes, CellCount,
+			(NumOfBits >= 8) ? 1 : nPlane, NumOfBits);
+		return (nPlane * NumOfBits <= 8);
 	}
 
-	for (int idx=1; idx < MyNumIndexRaw; idx ++)
+	// alleles in bytes, only reference or not is needed for dosages
+	if (BufU8.size() < CellCount + Num_Sample)
+		BufU8.resize(CellCount + Num_Sample);
+	C_UInt8 *g = &BufU8[0];
+	if (nPlane * NumOfBits <= 8)
 	{
-		GDS_Iter_Position(Node, &it, (C_Int64(IndexRaw) + idx)*SlideCnt);
-		GDS_Iter_RDataEx(&it, &Init.GENO_BUFFER[0], SlideCnt, svUInt8, SelPtr[1]);
+		vec_geno_merge_u8(g, Planes, CellCount, nPlane, NumOfBits);
+	} else {
+		if (BufI32.size() < CellCount)
+			BufI32.resize(CellCount);
+		int *p = &BufI32[0];
+		vec_geno_merge_i32(p, Planes, CellCount, nPlane, NumOfBits);
+		for (size_t n=CellCount; n > 0; n--, p++)
+			*g++ = (*p == NA_INTEGER) ? NA_RAW : ((*p == 0) ? 0 : 1);
+		g = &BufU8[0];
+	}
 
-		C_UInt8 shift = idx * NumOfBits;
-		C_UInt8 *s = &Init.GENO_BUFFER[0];
-		C_UInt8 *p = Base;
-		for (int n=Num_Sample; n > 0 ; n--)
+	switch (Type)
+	{
+	case goDosagePacked:
+		vec_dosage_pack2((C_UInt8*)Out, g, Num_Sample, DLen[2], Alt);
+		break;
+	case goDosageRaw:
+		vec_dosage_u8((C_UInt8*)Out, g, Num_Sample, DLen[2], Alt);
+		break;
+	default:
 		{
-			for (int m=DLen[2]; m > 0 ; m--)
-				*p++ |= (*s++) << shift;
+			C_UInt8 *d = g + CellCount;
+			vec_dosage_u8(d, g, Num_Sample, DLen[2], Alt);
+			int *p = (int*)Out;
+			for (int n=Num_Sample; n > 0; n--, d++)
+				*p++ = (*d == NA_RAW) ? NA_INTEGER : *d;
 		}
-
-		missing = (missing << NumOfBits) | bit_mask;
 	}
+	return true;
+}
 
+void CVarApplyByVariant::ReadGenoData(C_UInt8 *Base)
+{
+	// merge bit planes and replace missing values in one pass
 	// CellCount = Num_Sample * DLen[2] in 'NeedRData'
-	for (size_t n=CellCount; n > 0; n--)
-	{
-		if (*Base == missing) *Base = NA_RAW;
-		Base ++;
-	}	
+	if (!UnpackGeno(Base, goRaw, false, ReadGenoPlanes(NumIndexRaw),
+			NumIndexRaw, PackedGeno, PackedGenoI32))
+		warning("RAW type may not be sufficient to store genotypes.");
+}
+
+void CVarApplyByVariant::ReadGenoPacked(C_UInt8 *Base)
+{
+	UnpackGeno(Base, goDosagePacked, false, ReadGenoPlanes(NumIndexRaw),
+		NumIndexRaw, PackedGeno, PackedGenoI32);
 }
 
 void CVarApplyByVariant::ReadData(SEXP Val)
@@ -306,7 +411,9 @@ void CVarApplyByVariant::ReadData(SEXP Val)
 	if (NumIndexRaw <= 0) return;
 	if (VarType == ctGenotype)
 	{
-		if (UseRaw)
+		if (UsePacked)
+			ReadGenoPacked(RAW(Val));
+		else if (UseRaw)
 			ReadGenoData(RAW(Val));
 		else
 			ReadGenoData(INTEGER(Val));
@@ -363,7 +470,9 @@ SEXP CVarApplyByVariant::NeedRData(int &nProtected)
 		{
 			if (VarType == ctGenotype)
 			{
-				if (UseRaw)
+				if (UsePacked)
+					PROTECT(ans = NEW_RAW(PackedSize()));
+				else if (UseRaw)
 					PROTECT(ans = NEW_RAW(CellCount));
 				else
 					PROTECT(ans = NEW_INTEGER(CellCount));
@@ -398,6 +507,7 @@ SEXP CVarApplyByVariant::NeedRData(int &nProtected)
 		switch (VarType)
 		{
 		case ctGenotype:
+			if (!UsePacked)
 			{
 				int *p = INTEGER(dim = NEW_INTEGER(2));
 				p[0] = DLen[2]; p[1] = Num_Sample;
@@ -455,13 +565,17 @@ extern "C"
 
 /// Apply functions over margins on a working space
 COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
-	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP list_duplicate,
-	SEXP rho)
+	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP use_packed,
+	SEXP list_duplicate, SEXP rho)
 {
 	int use_raw_flag = Rf_asLogical(use_raw);
 	if (use_raw_flag == NA_LOGICAL)
 		error("'.useraw' must be TRUE or FALSE.");
 
+	int packed_flag = Rf_asLogical(use_packed);
+	if (packed_flag == NA_LOGICAL)
+		error("'.packed' must be TRUE or FALSE.");
+
 	int dup_flag = Rf_asLogical(list_duplicate);
 	if (dup_flag == NA_LOGICAL)
 		error("'.duplicate' must be TRUE or FALSE.");
@@ -493,7 +607,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
 		int nProtected = 0;
 
 		// the number of selected variants
-		int nVariant = GetNumOfTRUE(&Sel.Variant[0], Sel.Variant.size());
+		int nVariant = Sel.Variant.count();
 		if (nVariant <= 0)
 			throw ErrSeqArray("There is no selected variant.");
 
@@ -545,9 +659,11 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
 					s.c_str());
 			}
 
-			NodeList[i].InitObject(VarType, s.c_str(), Root, Sel.Variant.size(),
-				&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0],
-				use_raw_flag != FALSE);
+			NodeList[i].InitObject(VarType, s.c_str(), gdsfile, Sel.Variant,
+				Sel.Sample, use_raw_flag != FALSE);
+			NodeList[i].SetBlockRead(VARIANT_BLOCK_SIZE);
+			if (VarType == CVarApplyByVariant::ctGenotype)
+				NodeList[i].SetPacked(packed_flag != FALSE);
 		}
 
 		// ===========================================================
@@ -731,7 +847,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SlidingWindow(SEXP gdsfile, SEXP var_name,
 		int nProtected = 0;
 
 		// the number of selected variants
-		int nVariant = GetNumOfTRUE(&Sel.Variant[0], Sel.Variant.size());
+		int nVariant = Sel.Variant.count();
 		if (nVariant <= 0)
 			throw ErrSeqArray("There is no selected variant.");
 
@@ -790,8 +906,9 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SlidingWindow(SEXP gdsfile, SEXP var_name,
 					s.c_str());
 			}
 
-			NodeList[i].InitObject(VarType, s.c_str(), Root, Sel.Variant.size(),
-				&Sel.Variant[0], Sel.Sample.size(), &Sel.Sample[0], false);
+			NodeList[i].InitObject(VarType, s.c_str(), gdsfile, Sel.Variant,
+				Sel.Sample, false);
+			NodeList[i].SetBlockRead(VARIANT_BLOCK_SIZE);
 		}
 
 		// ===========================================================
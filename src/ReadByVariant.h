@@ -24,12 +24,19 @@
 
 // ===================================================================== //
 
+/// the default number of variants per block in reading genotypes
+#define VARIANT_BLOCK_SIZE           1024
+/// the max size of genotype buffer in a block
+#define VARIANT_BLOCK_MAX_BUFFER     (64*1024*1024)
+
+
 /// Object for reading a variable variant by variant
 class COREARRAY_DLL_LOCAL CVarApplyByVariant: public CVarApply
 {
 protected:
 	PdAbstractArray Node;       ///< the GDS variable
 	PdAbstractArray IndexNode;  ///< the corresponding index variable
+	TInitObject::TIndex *Index; ///< the cumulative offsets of IndexNode
 
 	C_Int32 IndexRaw;          ///< the index according to the raw data set
 	C_Int32 NumIndexRaw;       ///< the increment of raw index
@@ -38,12 +45,31 @@ protected:
 
 	C_SVType SVType;        ///< data type for GDS reading
 	C_BOOL *SelPtr[3];      ///< pointers to selection
-	C_BOOL *VariantSelect;  ///< pointer to variant selection
+	CSelection VariantSelect;  ///< the variant selection
+	CSelection SampleSelect;   ///< the sample selection
+	vector<C_BOOL> SampleBuf;  ///< the sample selection in reading GDS
 	bool UseRaw;            ///< whether use RAW type
+	bool UsePacked;         ///< whether use 2-bit packed dosages for genotypes
 
 	vector<C_BOOL> Selection;  ///< the buffer of selection
 	int NumOfBits;             ///< the number of bits
 
+	int BlockSize;          ///< the max number of variants per block, 0 for no block
+	C_Int32 BlockStart;     ///< the first variant index in the block
+	C_Int32 BlockEnd;       ///< the variant index after the block
+	vector<C_UInt8> BlockGeno;   ///< genotypes of the selected variants in the block
+	vector<size_t> BlockOffset;  ///< offsets in BlockGeno for variants in the block
+	vector<C_BOOL> BlockSel;     ///< selection of raw indices in the block
+	vector<C_UInt8> PackedGeno;  ///< the genotype buffer for packed dosages
+	vector<int> PackedGenoI32;   ///< the genotype buffer for wide alleles
+
+	/// load genotypes of a contiguous run of variants starting from CurIndex
+	void LoadGenoBlock();
+	/// get genotypes of the current variant from the block
+	C_UInt8 *GenoBlock();
+	/// get nPlane bit planes of the current variant, CellCount apart
+	C_UInt8 *ReadGenoPlanes(int nPlane);
+
 public:
 	TType VarType;          ///< VCF data type
 	int TotalNum_Variant;   ///< the total number of variants
@@ -56,17 +82,47 @@ public:
 	CVarApplyByVariant();
 	virtual ~CVarApplyByVariant() {}
 
-	void InitObject(TType Type, const char *Path, PdGDSObj Root,
-		int nVariant, C_BOOL *VariantSel, int nSample, C_BOOL *SampleSel,
+	void InitObject(TType Type, const char *Path, SEXP gdsfile,
+		const CSelection &VariantSel, const CSelection &SampleSel,
 		bool _UseRaw);
 	void ResetObject();
 
+	/// enable block reading of genotypes, nVariant = 0 to disable
+	void SetBlockRead(int nVariant);
+	/// return genotypes as 2-bit packed dosages of reference allele
+	void SetPacked(bool packed);
+
 	bool NextCell();
 
 	/// read genotypes in 32-bit integer
 	void ReadGenoData(int *Base);
 	/// read genotypes in unsigned 8-bit intetger
 	void ReadGenoData(C_UInt8 *Base);
+	/// read dosages of reference allele in 2 bits, 4 samples per byte
+	void ReadGenoPacked(C_UInt8 *Base);
+	/// read bit planes of genotypes, valid until the next reading
+	const C_UInt8 *ReadGenoRaw(int &nPlane);
+
+	/// output types of genotypes
+	enum TGenoOut
+	{
+		goInt32,        ///< alleles in 32-bit integers
+		goRaw,          ///< alleles in unsigned 8-bit integers
+		goDosageInt32,  ///< dosages in 32-bit integers, one per sample
+		goDosageRaw,    ///< dosages in bytes, one per sample
+		goDosagePacked  ///< dosages in 2 bits, 4 samples per byte
+	};
+	/// the number of bytes of an output type per variant
+	size_t GenoOutSize(TGenoOut Type) const;
+	/// unpack bit planes from ReadGenoRaw(), thread-safe with own buffers
+	/** \param Out     the output of GenoOutSize(Type) bytes
+	 *  \param Alt     dosages of alternate alleles instead of reference allele
+	 *  \return false if RAW type is not sufficient to store alleles
+	**/
+	bool UnpackGeno(void *Out, TGenoOut Type, bool Alt, const C_UInt8 *Planes,
+		int nPlane, vector<C_UInt8> &BufU8, vector<int> &BufI32) const;
+	/// the number of bytes of packed dosages per variant
+	inline size_t PackedSize() const { return (Num_Sample + 3) / 4; }
 
 	void ReadData(SEXP Val);
 
@@ -79,8 +135,8 @@ extern "C"
 {
 /// Apply functions over margins on a working space
 COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
-	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP list_duplicate,
-	SEXP rho);
+	SEXP FUN, SEXP as_is, SEXP var_index, SEXP use_raw, SEXP use_packed,
+	SEXP list_duplicate, SEXP rho);
 
 /// Apply functions via a sliding window over variants
 COREARRAY_DLL_EXPORT SEXP SEQ_SlidingWindow(SEXP gdsfile, SEXP var_name,
@@ -29,6 +29,151 @@
 
 
 
+// ===========================================================
+// Bit-packed Selection
+// ===========================================================
+
+CSelection::CSelection()
+{
+	fSize = 0;
+	fCount = 0;
+}
+
+void CSelection::clear()
+{
+	vector<C_UInt64> tmp1;
+	fBits.swap(tmp1);
+	fSize = 0;
+	fCount = 0;
+}
+
+void CSelection::resize(size_t n, bool val)
+{
+	if (n > fSize)
+	{
+		fBits.resize((n + 63) >> 6, 0);
+		if (val)
+		{
+			// set the bits in the last partial word of the old size
+			size_t i = fSize;
+			for (; (i < n) && (i & 0x3F); i++)
+				fBits[i >> 6] |= C_UInt64(1) << (i & 0x3F);
+			for (; i < n; i += 64)
+				fBits[i >> 6] = ~C_UInt64(0);
+		}
+	}
+	fSize = n;
+	fBits.resize((n + 63) >> 6);
+	// clear the unused bits in the last word
+	if (n & 0x3F)
+		fBits.back() &= (C_UInt64(1) << (n & 0x3F)) - 1;
+	fCount = -1;
+}
+
+void CSelection::assign(const C_BOOL *p, size_t n)
+{
+	fSize = n;
+	fBits.assign((n + 63) >> 6, 0);
+	for (size_t i=0; i < n; i++)
+	{
+		if (*p++)
+			fBits[i >> 6] |= C_UInt64(1) << (i & 0x3F);
+	}
+	fCount = -1;
+}
+
+size_t CSelection::count() const
+{
+	if (fCount < 0)
+	{
+		size_t n = 0;
+		for (vector<C_UInt64>::const_iterator it=fBits.begin();
+				it != fBits.end(); it++)
+			n += POPCNT_U64(*it);
+		fCount = n;
+	}
+	return fCount;
+}
+
+size_t CSelection::next(size_t i) const
+{
+	if (i >= fSize) return fSize;
+	size_t w = i >> 6;
+	C_UInt64 v = fBits[w] & (~C_UInt64(0) << (i & 0x3F));
+	while (v == 0)
+	{
+		if (++w >= fBits.size()) return fSize;
+		v = fBits[w];
+	}
+	return (w << 6) + CTZ_U64(v);
+}
+
+size_t CSelection::last() const
+{
+	for (size_t w=fBits.size(); w > 0; w--)
+	{
+		C_UInt64 v = fBits[w-1];
+		if (v != 0)
+		{
+			int b = 63;
+			while (!((v >> b) & 0x01)) b --;
+			return ((w-1) << 6) + b;
+		}
+	}
+	return fSize;
+}
+
+size_t CSelection::skip(size_t i, size_t num) const
+{
+	// skip whole words according to the number of bits set
+	while ((num > 0) && (i < fSize))
+	{
+		size_t w = i >> 6;
+		size_t c = POPCNT_U64(fBits[w] & (~C_UInt64(0) << (i & 0x3F)));
+		if (c >= num) break;
+		num -= c;
+		i = (w + 1) << 6;
+	}
+	for (; num > 0; num--)
+		i = next(i) + 1;
+	return (i < fSize) ? i : fSize;
+}
+
+size_t CSelection::unselect(size_t i, size_t num)
+{
+	for (; num > 0; num--)
+	{
+		i = next(i);
+		fBits[i >> 6] &= ~(C_UInt64(1) << (i & 0x3F));
+		i ++;
+	}
+	fCount = -1;
+	return i;
+}
+
+C_BOOL *CSelection::view(vector<C_BOOL> &buf) const
+{
+	buf.resize(fSize);
+	C_BOOL *p = buf.empty() ? NULL : &buf[0];
+	for (size_t i=0; i < fSize; i += 64)
+	{
+		C_UInt64 v = fBits[i >> 6];
+		size_t n = fSize - i;
+		if (n > 64) n = 64;
+		for (; n > 0; n--, v >>= 1)
+			*p++ = (v & 0x01);
+	}
+	return buf.empty() ? NULL : &buf[0];
+}
+
+void CSelection::get(size_t i, size_t n, C_BOOL *out) const
+{
+	for (; n > 0; n--, i++)
+		*out++ = (fBits[i >> 6] >> (i & 0x3F)) & 0x01;
+}
+
+
+
 // ===========================================================
 // The Initialized Object
 // ===========================================================
@@ -48,6 +193,55 @@ TInitObject::TSelection &TInitObject::Selection(SEXP gds)
 	return m.back();
 }
 
+TInitObject::TIndex &TInitObject::Index(SEXP gds, const char *path,
+	PdAbstractArray IndexNode)
+{
+	int id = INTEGER(GetListElement(gds, "id"))[0];
+	TIndex &I = _IndexMap[id][path];
+	if ((I.Node != IndexNode) ||
+			(I.Offset.size() != (size_t)GDS_Array_GetTotalCount(IndexNode) + 1))
+		I.Load(IndexNode);
+	return I;
+}
+
+void TInitObject::TIndex::Load(PdAbstractArray IndexNode)
+{
+	static const C_Int32 BLOCK = 65536;
+	C_Int32 nTotal = GDS_Array_GetTotalCount(IndexNode);
+	vector<C_Int32> buf(BLOCK);
+
+	Node = IndexNode;
+	Offset.resize(nTotal + 1);
+	C_Int64 *p = &Offset[0], sum = 0;
+	*p++ = 0;
+	for (C_Int32 st=0; st < nTotal; st += BLOCK)
+	{
+		C_Int32 cnt = nTotal - st;
+		if (cnt > BLOCK) cnt = BLOCK;
+		GDS_Array_ReadData(IndexNode, &st, &cnt, &buf[0], svInt32);
+		for (C_Int32 i=0; i < cnt; i++)
+		{
+			if (buf[i] > 0) sum += buf[i];
+			*p++ = sum;
+		}
+	}
+}
+
+void TInitObject::TIndex::GetRange(size_t i, size_t n, C_Int32 &Start,
+	C_Int32 &Len) const
+{
+	const C_Int64 st = Offset[i], end = Offset[i + n];
+	// the start and length are no larger than the end
+	if (end > 2147483647)
+	{
+		throw ErrSeqArray(
+			"The raw index (%lld) of variant %lld is out of the range of "
+			"32-bit integers.", (long long)end, (long long)(i + n));
+	}
+	Start = st;
+	Len = end - st;
+}
+
 void TInitObject::Need_GenoBuffer(size_t size)
 {
 	if (size > GENO_BUFFER.size())
@@ -184,6 +378,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_File_Init(SEXP gdsfile)
 		TInitObject::TSelection &s = Init.Selection(gdsfile);
 		s.Sample.clear();
 		s.Variant.clear();
+		int gds_file_id = Rf_asInteger(GetListElement(gdsfile, "id"));
+		Init._IndexMap.erase(gds_file_id);
 	COREARRAY_CATCH
 }
 
@@ -196,6 +392,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_File_Done(SEXP gdsfile)
 			Init._Map.find(gds_file_id);
 		if (it != Init._Map.end())
 			Init._Map.erase(it);
+		Init._IndexMap.erase(gds_file_id);
 	COREARRAY_CATCH
 }
 
@@ -270,10 +467,9 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 		PdAbstractArray varSamp = GDS_Node_Path(Root, "sample.id", TRUE);
 		int Count = GetGDSObjCount(varSamp, "sample.id");
 
-		vector<C_BOOL> &flag_array = Init.Selection(gdsfile).Sample;
+		CSelection &flag_array = Init.Selection(gdsfile).Sample;
 		if (flag_array.empty())
 			flag_array.resize(Count, TRUE);
-		C_BOOL *pArray = &flag_array[0];
 
 		if (Rf_isLogical(samp_sel) || IS_RAW(samp_sel))
 		{
@@ -287,14 +483,14 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 				{
 					int *base = LOGICAL(samp_sel);
 					for (int i=0; i < Count; i++)
-						*pArray++ = ((*base++) == TRUE);
+						flag_array.set(i, (*base++) == TRUE);
 				} else {
 					Rbyte *base = RAW(samp_sel);
 					for (int i=0; i < Count; i++)
-						*pArray++ = ((*base++) != 0);
+						flag_array.set(i, (*base++) != 0);
 				}
 			} else {
-				if ((size_t)XLENGTH(samp_sel) != GetNumOfTRUE(pArray, flag_array.size()))
+				if ((size_t)XLENGTH(samp_sel) != flag_array.count())
 				{
 					throw ErrSeqArray(
 						"Invalid length of 'samp.sel' "
@@ -304,17 +500,17 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 				if (Rf_isLogical(samp_sel))
 				{
 					int *base = LOGICAL(samp_sel);
-					for (int i=0; i < Count; i++, pArray++)
+					for (int i=0; i < Count; i++)
 					{
-						if (*pArray)
-							*pArray = ((*base++) == TRUE);
+						if (flag_array[i])
+							flag_array.set(i, (*base++) == TRUE);
 					}
 				} else {
 					Rbyte *base = RAW(samp_sel);
 					for (int i=0; i < Count; i++)
 					{
-						if (*pArray)
-							*pArray = ((*base++) != 0);
+						if (flag_array[i])
+							flag_array.set(i, (*base++) != 0);
 					}
 				}
 			}
@@ -332,12 +528,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isReal(samp_sel))
@@ -354,12 +550,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isString(samp_sel))
@@ -378,12 +574,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(sample_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isNull(samp_sel))
@@ -392,7 +588,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_sel,
 		} else
 			throw ErrSeqArray("Invalid type of 'samp_sel'.");
 
-		int n = GetNumOfTRUE(&flag_array[0], flag_array.size());
+		int n = flag_array.count();
 		if (Rf_isNull(samp_sel)) n = Count;
 		if (Rf_asLogical(verbose) == TRUE)
 			Rprintf("# of selected samples: %d\n", n);
@@ -413,10 +609,9 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 		PdAbstractArray varVariant = GDS_Node_Path(Root, "variant.id", TRUE);
 		int Count = GetGDSObjCount(varVariant, "variant.id");
 
-		vector<C_BOOL> &flag_array = Init.Selection(gdsfile).Variant;
+		CSelection &flag_array = Init.Selection(gdsfile).Variant;
 		if (flag_array.empty())
 			flag_array.resize(Count, TRUE);
-		C_BOOL *pArray = &flag_array[0];
 
 		if (Rf_isLogical(var_sel) || IS_RAW(var_sel))
 		{
@@ -430,14 +625,14 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 				{
 					int *base = LOGICAL(var_sel);
 					for (int i=0; i < Count; i++)
-						*pArray++ = ((*base++) == TRUE);
+						flag_array.set(i, (*base++) == TRUE);
 				} else {
 					Rbyte *base = RAW(var_sel);
 					for (int i=0; i < Count; i++)
-						*pArray++ = ((*base++) != 0);
+						flag_array.set(i, (*base++) != 0);
 				}
 			} else {
-				if ((size_t)XLENGTH(var_sel) != GetNumOfTRUE(pArray, flag_array.size()))
+				if ((size_t)XLENGTH(var_sel) != flag_array.count())
 				{
 					throw ErrSeqArray(
 						"Invalid length of 'variant.sel' "
@@ -447,17 +642,17 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 				if (Rf_isLogical(var_sel))
 				{
 					int *base = LOGICAL(var_sel);
-					for (int i=0; i < Count; i++, pArray++)
+					for (int i=0; i < Count; i++)
 					{
-						if (*pArray)
-							*pArray = ((*base++) == TRUE);
+						if (flag_array[i])
+							flag_array.set(i, (*base++) == TRUE);
 					}
 				} else {
 					Rbyte *base = RAW(var_sel);
 					for (int i=0; i < Count; i++)
 					{
-						if (*pArray)
-							*pArray = ((*base++) != 0);
+						if (flag_array[i])
+							flag_array.set(i, (*base++) != 0);
 					}
 				}
 			}
@@ -475,12 +670,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isReal(var_sel))
@@ -497,12 +692,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isString(var_sel))
@@ -522,12 +717,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 			if (!intersect_flag)
 			{
 				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
+					flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 			} else {
-				for (int i=0; i < Count; i++, pArray++)
+				for (int i=0; i < Count; i++)
 				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
+					if (flag_array[i])
+						flag_array.set(i, set_id.find(var_id[i]) != set_id.end());
 				}
 			}
 		} else if (Rf_isNull(var_sel))
@@ -536,7 +731,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_sel,
 		} else
 			throw ErrSeqArray("Invalid type of 'samp_sel'.");
 
-		int n = GetNumOfTRUE(&flag_array[0], flag_array.size());
+		int n = flag_array.count();
 		if (Rf_isNull(var_sel)) n = Count;
 		if (Rf_asLogical(verbose) == TRUE)
 			Rprintf("# of selected variants: %d\n", n);
@@ -572,7 +767,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetChrom(SEXP gdsfile, SEXP include, SEXP is_num)
 				Inc.insert(CHAR(STRING_ELT(include, i)));
 		}
 
-		vector<C_BOOL> &array = Init.Selection(gdsfile).Variant;
+		CSelection &array = Init.Selection(gdsfile).Variant;
 		array.resize(nVariant);
 		string txt;
 
@@ -593,7 +788,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetChrom(SEXP gdsfile, SEXP include, SEXP is_num)
 			if (IncFlag && flag)
 				flag = (Inc.find(txt) != Inc.end());
 
-			array[i] = flag;
+			array.set(i, flag);
 		}
 
 	COREARRAY_CATCH
@@ -628,7 +823,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetSpace(SEXP gdsfile)
 			PROTECT(tmp = NEW_LOGICAL(s.Sample.size()));
 			nProtected ++;
 			for (int i=0; i < (int)s.Sample.size(); i++)
-				LOGICAL(tmp)[i] = (s.Sample[i] != 0);
+				LOGICAL(tmp)[i] = s.Sample[i];
 		}
 		SET_ELEMENT(rv_ans, 0, tmp);
 
@@ -642,7 +837,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetSpace(SEXP gdsfile)
 			PROTECT(tmp = NEW_LOGICAL(s.Variant.size()));
 			nProtected ++;
 			for (int i=0; i < (int)s.Variant.size(); i++)
-				LOGICAL(tmp)[i] = (s.Variant[i] != 0);
+				LOGICAL(tmp)[i] = s.Variant[i];
 		}
 		SET_ELEMENT(rv_ans, 1, tmp);
 
@@ -660,25 +855,6 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetSpace(SEXP gdsfile)
 
 // ===========================================================
 
-inline static C_BOOL *CLEAR_SELECTION(size_t num, C_BOOL *p)
-{
-	while (num > 0)
-	{
-		if (*p != FALSE) { num--; *p = FALSE; }
-		p ++;
-	}
-	return p;
-}
-inline static C_BOOL *SKIP_SELECTION(size_t num, C_BOOL *p)
-{
-	while (num > 0)
-	{
-		if (*p != FALSE) num--;
-		p ++;
-	}
-	return p;
-}
-
 /// split the selected variants according to multiple processes
 COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelection(SEXP gdsfile, SEXP split,
 	SEXP index, SEXP n_process, SEXP selection_flag)
@@ -695,7 +871,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelection(SEXP gdsfile, SEXP split,
 
 		// the total number of selected elements
 		int SelectCount;
-		C_BOOL *sel;
+		CSelection *sel;
 		if (strcmp(split_str, "by.variant") == 0)
 		{
 			if (s.Variant.empty())
@@ -704,8 +880,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelection(SEXP gdsfile, SEXP split,
 					GDS_Array_GetTotalCount(GDS_Node_Path(
 					GDS_R_SEXP2FileRoot(gdsfile), "variant.id", TRUE)), TRUE);
 			}
-			sel = &s.Variant[0];
-			SelectCount = GetNumOfTRUE(sel, s.Variant.size());
+			sel = &s.Variant;
+			SelectCount = sel->count();
 		} else if (strcmp(split_str, "by.sample") == 0)
 		{
 			if (s.Sample.empty())
@@ -714,8 +890,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelection(SEXP gdsfile, SEXP split,
 					GDS_Array_GetTotalCount(GDS_Node_Path(
 					GDS_R_SEXP2FileRoot(gdsfile), "sample.id", TRUE)), TRUE);
 			}
-			sel = &s.Sample[0];
-			SelectCount = GetNumOfTRUE(sel, s.Sample.size());
+			sel = &s.Sample;
+			SelectCount = sel->count();
 		} else {
 			return rv_ans;
 		}
@@ -732,17 +908,18 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelection(SEXP gdsfile, SEXP split,
 
 		// ---------------------------------------------------
 		int st = 0;
+		size_t pos = 0;
 		for (int i=0; i < Process_Index; i++)
 		{
-			sel = CLEAR_SELECTION(split[i] - st, sel);
+			pos = sel->unselect(pos, split[i] - st);
 			st = split[i];
 		}
 		int ans_n = split[Process_Index] - st;
-		sel = SKIP_SELECTION(ans_n, sel);
+		pos = sel->skip(pos, ans_n);
 		st = split[Process_Index];
 		for (int i=Process_Index+1; i < Num_Process; i++)
 		{
-			sel = CLEAR_SELECTION(split[i] - st, sel);
+			pos = sel->unselect(pos, split[i] - st);
 			st = split[i];
 		}
 
@@ -805,20 +982,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Summary(SEXP gdsfile, SEXP varname)
 				PROTECT(S32 = NEW_INTEGER(2));
 				SET_ELEMENT(rv_ans, 1, S32);
 				if (!Sel.Sample.empty())
-				{
-					int &n = INTEGER(S32)[0]; n = 0;
-					vector<C_BOOL>::iterator it;
-					for (it=Sel.Sample.begin(); it != Sel.Sample.end(); it ++)
-						if (*it) n ++;
-				} else
+					INTEGER(S32)[0] = Sel.Sample.count();
+				else
 					INTEGER(S32)[0] = INTEGER(I32)[1];
 				if (!Sel.Variant.empty())
-				{
-					int &n = INTEGER(S32)[1]; n = 0;
-					vector<C_BOOL>::iterator it;
-					for (it=Sel.Variant.begin(); it != Sel.Variant.end(); it ++)
-						if (*it) n ++;
-				} else
+					INTEGER(S32)[1] = Sel.Variant.count();
+				else
 					INTEGER(S32)[1] = INTEGER(I32)[2];
 
 			SEXP tmp;
@@ -935,9 +1104,13 @@ COREARRAY_DLL_EXPORT void R_init_SeqArray(DllInfo *info)
 
 	extern void Register_SNPRelate_Functions();
 
-	extern SEXP SEQ_GetData(SEXP, SEXP);
-	extern SEXP SEQ_Apply_Sample(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
-	extern SEXP SEQ_Apply_Variant(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+	extern SEXP SEQ_GetData(SEXP, SEXP, SEXP, SEXP);
+	extern SEXP SEQ_Apply_Sample(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP,
+		SEXP, SEXP);
+	extern SEXP SEQ_Apply_Variant(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP,
+		SEXP);
+	extern SEXP SEQ_Apply_Native(SEXP, SEXP, SEXP);
+	extern SEXP SEQ_IBD_OneLocus(SEXP, SEXP);
 	extern SEXP SEQ_ConvBEDFlag(SEXP, SEXP, SEXP);
 	extern SEXP SEQ_ConvBED2GDS(SEXP, SEXP, SEXP, SEXP, SEXP);
 
@@ -956,8 +1129,9 @@ COREARRAY_DLL_EXPORT void R_init_SeqArray(DllInfo *info)
 
 		CALL(SEQ_Summary, 2),
 
-		CALL(SEQ_GetData, 2),
-		CALL(SEQ_Apply_Sample, 7),          CALL(SEQ_Apply_Variant, 8),
+		CALL(SEQ_GetData, 4),
+		CALL(SEQ_Apply_Sample, 9),          CALL(SEQ_Apply_Variant, 9),
+		CALL(SEQ_Apply_Native, 3),          CALL(SEQ_IBD_OneLocus, 2),
 
 		CALL(SEQ_ConvBEDFlag, 3),           CALL(SEQ_ConvBED2GDS, 5),
 
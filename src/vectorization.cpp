@@ -0,0 +1,383 @@
+// ===========================================================
+//
+// vectorization.cpp: compiler optimization with vectorization
+//
+// Copyright (C) 2015    Xiuwen Zheng
+//
+// This file is part of SeqArray.
+//
+// SeqArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// SeqArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SeqArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "vectorization.h"
+
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
+#ifdef SEQ_VEC_CPU_DISPATCH
+#   include <immintrin.h>
+#endif
+
+
+/// the merged value of missing genotypes in 32-bit integer
+inline static int MISSING_I32(int nPlane, int nBit)
+{
+	const unsigned bit_mask = ~(~0u << nBit);
+	unsigned missing = bit_mask;
+	for (int i=1; i < nPlane; i++)
+		missing = (missing << nBit) | bit_mask;
+	return (int)missing;
+}
+
+/// the merged value of missing genotypes in unsigned 8-bit integer
+inline static C_UInt8 MISSING_U8(int nPlane, int nBit)
+{
+	const C_UInt8 bit_mask = (C_UInt8)~(~0u << nBit);
+	C_UInt8 missing = bit_mask;
+	for (int i=1; i < nPlane; i++)
+		missing = (missing << nBit) | bit_mask;
+	return missing;
+}
+
+
+
+// ===========================================================
+// Scalar implementation
+// ===========================================================
+
+/// merge from the i-th genotype, planes are n apart
+inline static void geno_merge_i32_from(size_t i, int *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit, int missing)
+{
+	for (; i < n; i++)
+	{
+		unsigned v = s[i];
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			v |= unsigned(*p) << (k * nBit);
+		}
+		out[i] = ((int)v != missing) ? (int)v : NA_INTEGER;
+	}
+}
+
+/// merge from the i-th genotype, planes are n apart
+inline static void geno_merge_u8_from(size_t i, C_UInt8 *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit, C_UInt8 missing)
+{
+	for (; i < n; i++)
+	{
+		C_UInt8 v = s[i];
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			const int shift = k * nBit;
+			if (shift >= 8) break;
+			v |= (C_UInt8)(*p << shift);
+		}
+		out[i] = (v != missing) ? v : NA_RAW;
+	}
+}
+
+#ifndef __SSE2__
+
+static void geno_merge_i32(int *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, int missing)
+{
+	geno_merge_i32_from(0, out, s, n, nPlane, nBit, missing);
+}
+
+static void geno_merge_u8(C_UInt8 *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, C_UInt8 missing)
+{
+	geno_merge_u8_from(0, out, s, n, nPlane, nBit, missing);
+}
+
+#endif
+
+
+
+// ===========================================================
+// SSE2 implementation
+// ===========================================================
+
+#ifdef __SSE2__
+
+static void geno_merge_i32_sse2(int *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, int missing)
+{
+	const __m128i Z = _mm_setzero_si128();
+	const __m128i MISS = _mm_set1_epi32(missing);
+	const __m128i NA = _mm_set1_epi32(NA_INTEGER);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((__m128i const*)(s + i));
+		__m128i lo = _mm_unpacklo_epi8(v, Z), hi = _mm_unpackhi_epi8(v, Z);
+		__m128i a0 = _mm_unpacklo_epi16(lo, Z), a1 = _mm_unpackhi_epi16(lo, Z);
+		__m128i a2 = _mm_unpacklo_epi16(hi, Z), a3 = _mm_unpackhi_epi16(hi, Z);
+
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			const __m128i sh = _mm_cvtsi32_si128(k * nBit);
+			v = _mm_loadu_si128((__m128i const*)p);
+			lo = _mm_unpacklo_epi8(v, Z); hi = _mm_unpackhi_epi8(v, Z);
+			a0 = _mm_or_si128(a0, _mm_sll_epi32(_mm_unpacklo_epi16(lo, Z), sh));
+			a1 = _mm_or_si128(a1, _mm_sll_epi32(_mm_unpackhi_epi16(lo, Z), sh));
+			a2 = _mm_or_si128(a2, _mm_sll_epi32(_mm_unpacklo_epi16(hi, Z), sh));
+			a3 = _mm_or_si128(a3, _mm_sll_epi32(_mm_unpackhi_epi16(hi, Z), sh));
+		}
+
+		#define SEQ_MERGE_NA(a)    \
+			{ __m128i m = _mm_cmpeq_epi32(a, MISS);  \
+			  a = _mm_or_si128(_mm_andnot_si128(m, a), _mm_and_si128(m, NA)); }
+		SEQ_MERGE_NA(a0) SEQ_MERGE_NA(a1) SEQ_MERGE_NA(a2) SEQ_MERGE_NA(a3)
+		#undef SEQ_MERGE_NA
+
+		_mm_storeu_si128((__m128i*)(out + i), a0);
+		_mm_storeu_si128((__m128i*)(out + i + 4), a1);
+		_mm_storeu_si128((__m128i*)(out + i + 8), a2);
+		_mm_storeu_si128((__m128i*)(out + i + 12), a3);
+	}
+
+	// the remaining part
+	geno_merge_i32_from(i, out, s, n, nPlane, nBit, missing);
+}
+
+static void geno_merge_u8_sse2(C_UInt8 *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, C_UInt8 missing)
+{
+	const __m128i MISS = _mm_set1_epi8(missing);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((__m128i const*)(s + i));
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			const int shift = k * nBit;
+			if (shift >= 8) break;
+			// 16-bit shifts, and remove the bits moving across bytes
+			const __m128i msk = _mm_set1_epi8((C_UInt8)(0xFF << shift));
+			__m128i v = _mm_loadu_si128((__m128i const*)p);
+			v = _mm_sll_epi16(v, _mm_cvtsi32_si128(shift));
+			a = _mm_or_si128(a, _mm_and_si128(v, msk));
+		}
+		// NA_RAW = 0xFF
+		a = _mm_or_si128(a, _mm_cmpeq_epi8(a, MISS));
+		_mm_storeu_si128((__m128i*)(out + i), a);
+	}
+
+	// the remaining part
+	geno_merge_u8_from(i, out, s, n, nPlane, nBit, missing);
+}
+
+#endif
+
+
+
+// ===========================================================
+// AVX2 implementation
+// ===========================================================
+
+#ifdef SEQ_VEC_CPU_DISPATCH
+
+__attribute__((target("avx2")))
+static void geno_merge_i32_avx2(int *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, int missing)
+{
+	const __m256i MISS = _mm256_set1_epi32(missing);
+	const __m256i NA = _mm256_set1_epi32(NA_INTEGER);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a[4];
+		for (int j=0; j < 4; j++)
+		{
+			a[j] = _mm256_cvtepu8_epi32(
+				_mm_loadl_epi64((__m128i const*)(s + i + 8*j)));
+		}
+
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			const __m128i sh = _mm_cvtsi32_si128(k * nBit);
+			for (int j=0; j < 4; j++)
+			{
+				__m256i v = _mm256_cvtepu8_epi32(
+					_mm_loadl_epi64((__m128i const*)(p + 8*j)));
+				a[j] = _mm256_or_si256(a[j], _mm256_sll_epi32(v, sh));
+			}
+		}
+
+		for (int j=0; j < 4; j++)
+		{
+			__m256i m = _mm256_cmpeq_epi32(a[j], MISS);
+			_mm256_storeu_si256((__m256i*)(out + i + 8*j),
+				_mm256_blendv_epi8(a[j], NA, m));
+		}
+	}
+
+	// the remaining part
+	geno_merge_i32_from(i, out, s, n, nPlane, nBit, missing);
+}
+
+__attribute__((target("avx2")))
+static void geno_merge_u8_avx2(C_UInt8 *out, const C_UInt8 *s, size_t n,
+	int nPlane, int nBit, C_UInt8 missing)
+{
+	const __m256i MISS = _mm256_set1_epi8(missing);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((__m256i const*)(s + i));
+		const C_UInt8 *p = s + i;
+		for (int k=1; k < nPlane; k++)
+		{
+			p += n;
+			const int shift = k * nBit;
+			if (shift >= 8) break;
+			// 16-bit shifts, and remove the bits moving across bytes
+			const __m256i msk = _mm256_set1_epi8((C_UInt8)(0xFF << shift));
+			__m256i v = _mm256_loadu_si256((__m256i const*)p);
+			v = _mm256_sll_epi16(v, _mm_cvtsi32_si128(shift));
+			a = _mm256_or_si256(a, _mm256_and_si256(v, msk));
+		}
+		// NA_RAW = 0xFF
+		a = _mm256_or_si256(a, _mm256_cmpeq_epi8(a, MISS));
+		_mm256_storeu_si256((__m256i*)(out + i), a);
+	}
+
+	// the remaining part
+	geno_merge_u8_from(i, out, s, n, nPlane, nBit, missing);
+}
+
+#endif
+
+
+
+// ===========================================================
+// Runtime selection
+// ===========================================================
+
+typedef void (*TMergeI32)(int*, const C_UInt8*, size_t, int, int, int);
+typedef void (*TMergeU8)(C_UInt8*, const C_UInt8*, size_t, int, int, C_UInt8);
+
+static TMergeI32 select_merge_i32()
+{
+#ifdef SEQ_VEC_CPU_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &geno_merge_i32_avx2;
+#endif
+#ifdef __SSE2__
+	return &geno_merge_i32_sse2;
+#else
+	return &geno_merge_i32;
+#endif
+}
+
+static TMergeU8 select_merge_u8()
+{
+#ifdef SEQ_VEC_CPU_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &geno_merge_u8_avx2;
+#endif
+#ifdef __SSE2__
+	return &geno_merge_u8_sse2;
+#else
+	return &geno_merge_u8;
+#endif
+}
+
+static TMergeI32 fn_merge_i32 = select_merge_i32();
+static TMergeU8 fn_merge_u8 = select_merge_u8();
+
+
+COREARRAY_DLL_LOCAL void vec_geno_merge_i32(int *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit)
+{
+	(*fn_merge_i32)(out, s, n, nPlane, nBit, MISSING_I32(nPlane, nBit));
+}
+
+COREARRAY_DLL_LOCAL void vec_geno_merge_u8(C_UInt8 *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit)
+{
+	(*fn_merge_u8)(out, s, n, nPlane, nBit, MISSING_U8(nPlane, nBit));
+}
+
+
+
+// ===========================================================
+// Packed dosages
+// ===========================================================
+
+COREARRAY_DLL_LOCAL void vec_dosage_pack2(C_UInt8 *out, const C_UInt8 *geno,
+	size_t nSample, int ploidy, bool alt)
+{
+	C_UInt8 b = 0;
+	size_t i = 0;
+	for (; i < nSample; i++, geno += ploidy)
+	{
+		C_UInt8 val = 0;
+		for (int m=0; m < ploidy; m++)
+		{
+			if (geno[m] == NA_RAW)
+			{
+				val = 3; break;
+			} else if ((geno[m] == 0) != alt)
+			{
+				if (val < 2) val ++;
+			}
+		}
+		b |= val << ((i & 0x03) << 1);
+		if ((i & 0x03) == 0x03)
+			{ *out++ = b; b = 0; }
+	}
+	if (i & 0x03)
+	{
+		for (; i & 0x03; i++)
+			b |= 0x03 << ((i & 0x03) << 1);
+		*out = b;
+	}
+}
+
+COREARRAY_DLL_LOCAL void vec_dosage_u8(C_UInt8 *out, const C_UInt8 *geno,
+	size_t nSample, int ploidy, bool alt)
+{
+	for (size_t i=0; i < nSample; i++, geno += ploidy)
+	{
+		C_UInt8 val = 0;
+		for (int m=0; m < ploidy; m++)
+		{
+			if (geno[m] == NA_RAW)
+			{
+				val = NA_RAW; break;
+			} else if ((geno[m] == 0) != alt)
+				val ++;
+		}
+		*out++ = val;
+	}
+}
@@ -0,0 +1,94 @@
+// ===========================================================
+//
+// vectorization.h: compiler optimization with vectorization
+//
+// Copyright (C) 2015    Xiuwen Zheng
+//
+// This file is part of SeqArray.
+//
+// SeqArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// SeqArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SeqArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_SEQ_VECTORIZATION_
+#define _HEADER_SEQ_VECTORIZATION_
+
+#include "Common.h"
+
+
+// ===========================================================
+// Whether SIMD instructions can be selected at runtime
+// ===========================================================
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   if defined(__clang__)
+#       if (__clang_major__ > 3) || ((__clang_major__==3) && (__clang_minor__>=8))
+#           define SEQ_VEC_CPU_DISPATCH
+#       endif
+#   elif (__GNUC__ > 4) || ((__GNUC__==4) && (__GNUC_MINOR__>=9))
+#       define SEQ_VEC_CPU_DISPATCH
+#   endif
+#endif
+
+
+
+// ===========================================================
+// Genotype bit planes
+// ===========================================================
+
+/// merge the bit planes of genotypes and replace missing values by NA
+/** \param out     the output, n integers
+ *  \param s       nPlane planes, each plane has n values
+ *  \param n       the number of genotypes
+ *  \param nPlane  the number of bit planes (>= 1, nPlane*nBit <= 31)
+ *  \param nBit    the number of bits per value in a plane
+**/
+COREARRAY_DLL_LOCAL void vec_geno_merge_i32(int *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit);
+
+/// merge the bit planes of genotypes and replace missing values by NA_RAW
+/** \param out     the output, n unsigned 8-bit integers
+ *  \param s       nPlane planes, each plane has n values
+ *  \param n       the number of genotypes
+ *  \param nPlane  the number of bit planes (>= 1), the bits beyond the
+ *                 first byte are ignored
+ *  \param nBit    the number of bits per value in a plane
+**/
+COREARRAY_DLL_LOCAL void vec_geno_merge_u8(C_UInt8 *out, const C_UInt8 *s,
+	size_t n, int nPlane, int nBit);
+
+/// pack the dosages of reference allele in 2 bits, 4 samples per byte
+/** \param out      the output, (nSample+3)/4 bytes, the first sample in
+ *                  the lowest two bits, with the unused bits set to 3
+ *  \param geno     nSample*ploidy alleles, NA_RAW for missing
+ *  \param nSample  the number of samples
+ *  \param ploidy   the number of alleles per sample
+ *  \param alt      if true, count alternate alleles instead
+ *  the dosage is the number of reference alleles (no more than 2), and 3
+ *  for a missing genotype
+**/
+COREARRAY_DLL_LOCAL void vec_dosage_pack2(C_UInt8 *out, const C_UInt8 *geno,
+	size_t nSample, int ploidy, bool alt=false);
+
+/// the dosages of reference allele in bytes, one sample per byte
+/** \param out      the output, nSample bytes
+ *  \param geno     nSample*ploidy alleles, NA_RAW for missing
+ *  \param nSample  the number of samples
+ *  \param ploidy   the number of alleles per sample
+ *  \param alt      if true, count alternate alleles instead
+ *  the dosage is NA_RAW for a missing genotype
+**/
+COREARRAY_DLL_LOCAL void vec_dosage_u8(C_UInt8 *out, const C_UInt8 *geno,
+	size_t nSample, int ploidy, bool alt=false);
+
+#endif /* _HEADER_SEQ_VECTORIZATION_ */